@@ -983,8 +983,8 @@ private:
     bool cur_control_trans = false;
     uint32_t delay_npc;
 public:
-    mips_mmu<16> mmu;
-    mips_cp0<16> cp0;
+    mips_mmu<CONFIG_TLB_NR> mmu;
+    mips_cp0<CONFIG_TLB_NR> cp0;
 };
 
 
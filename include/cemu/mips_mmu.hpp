@@ -3,6 +3,7 @@
 
 #include "paddr/paddr_interface.hpp"
 #include "mips_common.hpp"
+#include "tlb_index.hpp"
 #include <cstdint>
 
 template <int nr_tlb_entry = 8>
@@ -13,6 +14,7 @@ public:
     }
     void reset() {
         memset(tlb,0,sizeof(tlb));
+        tlb_idx.reset();
     }
     // Only mask high 3 bit to translate from va to pa.
     // TODO: impl TLB and virtual address space segments
@@ -98,6 +100,7 @@ public:
     void tlbw(mips_tlb tlb_entry, uint8_t idx) {
         assert(idx < nr_tlb_entry);
         tlb[idx] = tlb_entry;
+        tlb_idx.set(idx, tlb_entry.VPN2, tlb_entry.ASID, tlb_entry.G);
     }
 private:
     // don't care CCA
@@ -133,16 +136,11 @@ private:
         }
     }
     mips_tlb* tlb_match(uint32_t va, uint8_t asid) {
-        // printf("tlb match %x\n",va);
-        for (int i=0;i<nr_tlb_entry;i++) {
-            if ((asid == tlb[i].ASID || tlb[i].G) && tlb[i].VPN2 == (va >> 13)) {
-                // printf("tlb found!\n");
-                return &tlb[i];
-            }
-        }
-        return NULL;
+        int idx = tlb_idx.match(va >> 13, asid);
+        return idx < 0 ? NULL : &tlb[idx];
     }
     PaddrTop *bus;
+    tlb_index<nr_tlb_entry> tlb_idx;
 public:
     mips_tlb tlb[nr_tlb_entry];
 };
@@ -0,0 +1,14 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+#include "common.hpp"
+/*
+ * The whole machine of standalone nemu in one gzip file: ticks, the CPU
+ * (registers, CP0, TLB, delay slot), the devices of its SoC and the
+ * non-zero pages of its memory. A checkpoint is restored into a nemu of the
+ * same SoC, a file of another version or memory map is refused untouched.
+ */
+#ifdef CONFIG_CHECKPOINT
+bool checkpoint_save(const char* filename);
+bool checkpoint_load(const char* filename);
+#endif
+#endif
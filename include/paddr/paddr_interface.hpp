@@ -1,10 +1,13 @@
 #ifndef __PADDR_IF_HH__
 #define __PADDR_IF_HH__
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include <queue>
 #include "common.hpp"
+#include "snapshot.hpp"
 #include "testbench/difftest/struct.hpp"
 #include "easylogging++.h"
 #include <mutex>
@@ -35,30 +38,84 @@ class AddrIntv {// address interval{{{
     }
 };/*}}}*/
 
+// called with the host address of every store into Pmem
+typedef void (*write_hook_t)(const uint8_t* host_addr);
+
+typedef enum {/*{{{*/
+    BURST_FIXED = 0,
+    BURST_INCR  = 1,
+    BURST_WRAP  = 2,
+    BURST_RESERVED  = 3
+}burst_t;/*}}}*/
+
+// address of beat i of a burst of len beats of size bytes, as AXI counts it
+static inline word_t burst_beat_addr(word_t addr, int size, int len, burst_t burst, int i){/*{{{*/
+    switch (burst) {
+        case BURST_INCR:
+            return addr + i * size;
+        case BURST_WRAP: {
+            word_t wrap_mask = size * len - 1;
+            return (addr & ~wrap_mask) | ((addr + i * size) & wrap_mask);
+        }
+        default:
+            return addr;
+    }
+}/*}}}*/
+
 class PaddrInterface {/*{{{*/
     public:
         virtual bool do_read (word_t addr, wen_t info, word_t* data) = 0;
         virtual bool do_write(word_t addr, wen_t info, const word_t data) = 0;
+        /*
+         * A burst of len beats of info.size bytes from addr, beat i is at
+         * data + i * info.size. The default does one do_read/do_write per beat,
+         * beats wider than a word one per word; memory does a copy. Bursts never
+         * cross a 4KB page.
+         */
+        virtual bool burst_read (word_t addr, wen_t info, int len, burst_t burst, uint8_t* data){/*{{{*/
+            bool res = true;
+            wen_t word = {.size = (unsigned char)std::min<int>(info.size, 4), .wstrb = 0xf};
+            for (int i = 0; i < len; i++) {
+                word_t beat_addr = burst_beat_addr(addr, info.size, len, burst, i);
+                for (int off = 0; off < info.size; off += 4) {
+                    word_t value = 0;
+                    res &= do_read(beat_addr + off, word, &value);
+                    memcpy(data + i * info.size + off, &value, word.size);
+                }
+            }
+            return res;
+        }/*}}}*/
+        virtual bool burst_write(word_t addr, const wen_t* info, int len, burst_t burst, const uint8_t* data){/*{{{*/
+            bool res = true;
+            for (int i = 0; i < len; i++) {
+                word_t beat_addr = burst_beat_addr(addr, info[i].size, len, burst, i);
+                for (int off = 0; off < info[i].size; off += 4) {
+                    wen_t word = {.size = (unsigned char)std::min<int>(info[i].size, 4),
+                        .wstrb = (uint16_t)(info[i].wstrb >> off & 0xf)};
+                    if (info[i].size > 4 && word.wstrb == 0) continue;
+                    word_t value = 0;
+                    memcpy(&value, data + i * info[i].size + off, word.size);
+                    res &= do_write(beat_addr + off, word, value);
+                }
+            }
+            return res;
+        }/*}}}*/
         el::Logger* log_pt;
         virtual void set_logger(el::Logger* input_logger){ log_pt = input_logger; }
+        virtual void set_write_hook(write_hook_t hook){}
+        // nullptr if addr is not backed by host memory
+        virtual uint8_t* get_host_ptr(word_t addr){ return nullptr; }
+        // device registers and queues, memory contents are left to the caller
+        virtual void save_state(snap_writer& out){}
+        virtual bool load_state(snap_reader& in){ return true; }
         PaddrInterface(el::Logger* input_logger = el::Loggers::getLogger("default")): log_pt(input_logger) {}
 };/*}}}*/
 
-class PaddrTop: public PaddrInterface{/*{{{*/
-    private:
-        std::vector<std::pair<AddrIntv, PaddrInterface*>> devices;
-    public:
-        PaddrTop(el::Logger* input_logger = el::Loggers::getLogger("default"));
-        bool add_dev(AddrIntv &new_range, PaddrInterface *dev);
-        bool do_read (word_t addr, wen_t info, word_t* data);
-        bool do_write(word_t addr, wen_t info, const word_t data);
-        void set_logger(el::Logger* input_logger);
-};/*}}}*/
-
-class Pmem : public PaddrInterface  {/*{{{*/
+class Pmem final: public PaddrInterface  {/*{{{*/
     private:
         unsigned char *mem;
         size_t mem_size;
+        write_hook_t write_hook;
     public:
         Pmem(word_t size_bytes, 
                 el::Logger* input_logger = el::Loggers::getLogger("default"));
@@ -70,11 +127,165 @@ class Pmem : public PaddrInterface  {/*{{{*/
                 el::Logger* input_logger = el::Loggers::getLogger("default"));
         Pmem(const Pmem &src);
         ~Pmem() ;
-        bool do_read (word_t addr, wen_t info, word_t* data);
-        bool do_write(word_t addr, wen_t info, const word_t data);
+        // inline, PaddrTop calls them without virtual dispatch
+        inline bool do_read (word_t addr, wen_t info, word_t* data){/*{{{*/
+            bool res = true;
+            switch (info.size) {
+                case 1: 
+                    *(uint8_t*) data = *(uint8_t*)(mem+addr);
+                    break;
+                case 2: 
+                    *(uint16_t*) data = *(uint16_t*)(mem+addr);
+                    break;
+                case 4: 
+                    *(uint32_t*) data = *(uint32_t*)(mem+addr);
+                    break;
+                default:
+                    res = false;
+                    Assert(0,"Pmem read not support size:%x",info.size);
+            }
+            return res;
+        }/*}}}*/
+        inline bool do_write(word_t addr, wen_t info, const word_t data){/*{{{*/
+            bool res = true;
+            switch (info.size) {
+                case 1: 
+                    *(uint8_t*)(mem+addr) = (uint8_t)data ;
+                    break;
+                case 2: 
+                    *(uint16_t*)(mem+addr) = (uint16_t)data ;
+                    break;
+                case 4: 
+                    if (likely(info.wstrb==0xf)) *(uint32_t*)(mem+addr) = data;
+                    else {
+                        if (BITS(info.wstrb,0,0)) *(uint8_t *)(mem+addr+0) = BITS(data,7,0); 
+                        if (BITS(info.wstrb,1,1)) *(uint8_t *)(mem+addr+1) = BITS(data,15,8);
+                        if (BITS(info.wstrb,2,2)) *(uint8_t *)(mem+addr+2) = BITS(data,23,16);
+                        if (BITS(info.wstrb,3,3)) *(uint8_t *)(mem+addr+3) = BITS(data,31,24);
+                    }
+                    break;
+                default:
+                    res = false;
+                    Assert(0,"Pmem read not support size:%x",info.size);
+            }
+            if (write_hook) write_hook(mem+addr);
+            return res;
+        }/*}}}*/
+        // INCR and WRAP bursts are one or two copies, unless some byte is not enabled
+        inline bool burst_read (word_t addr, wen_t info, int len, burst_t burst, uint8_t* data){/*{{{*/
+            if (burst == BURST_FIXED) return PaddrInterface::burst_read(addr, info, len, burst, data);
+            word_t bytes = len * info.size;
+            word_t first = burst == BURST_WRAP ? bytes - (addr & (bytes - 1)) : bytes;
+            memcpy(data, mem + addr, first);
+            memcpy(data + first, mem + addr + first - bytes, bytes - first);
+            return true;
+        }/*}}}*/
+        inline bool burst_write(word_t addr, const wen_t* info, int len, burst_t burst, const uint8_t* data){/*{{{*/
+            bool full = burst != BURST_FIXED;
+            for (int i = 0; i < len; i++) {
+                // like do_write, narrow beats have no strobe
+                uint16_t all = (1u << info[i].size) - 1;
+                full &= info[i].size < 4 || (info[i].wstrb & all) == all;
+            }
+            if (!full) return PaddrInterface::burst_write(addr, info, len, burst, data);
+            word_t bytes = len * info[0].size;
+            word_t first = burst == BURST_WRAP ? bytes - (addr & (bytes - 1)) : bytes;
+            memcpy(mem + addr, data, first);
+            memcpy(mem + addr + first - bytes, data + first, bytes - first);
+            if (write_hook) {
+                uint8_t* start = mem + addr + first - bytes;
+                for (word_t off = 0; off < bytes; off += 4) write_hook(start + off);
+            }
+            return true;
+        }/*}}}*/
         void load_binary(uint64_t addr, const char *init_file);
         void save_binary(const char *filename) ;
         uint8_t *get_mem_ptr();
+        inline size_t get_mem_size() { return mem_size; }
+        // copy in restored contents, the write hook sees every word
+        void restore(size_t offset, const uint8_t* data, size_t len);
+        void set_write_hook(write_hook_t hook){ write_hook = hook; }
+        uint8_t* get_host_ptr(word_t addr){ return mem + addr; }
+};/*}}}*/
+
+
+/*
+ * Devices are found through a two level table of 4KB pages filled by
+ * add_dev(), Pmem pages are accessed without a virtual call. Pages shared by
+ * devices smaller than a page, unmapped pages and accesses crossing a page
+ * search the device list as before.
+ */
+class PaddrTop final: public PaddrInterface{/*{{{*/
+    private:
+        std::vector<std::pair<AddrIntv, PaddrInterface*>> devices;
+        struct dev_page {
+            PaddrInterface* dev;    // nullptr: search devices
+            Pmem* pmem;             // dev if it is a Pmem
+            word_t mask;            // of the device range
+        };
+        static constexpr int PAGE_BITS = 12;
+        static constexpr int DIR_BITS  = 10;
+        std::unique_ptr<dev_page[]> page_dir[1 << (32 - DIR_BITS - PAGE_BITS)];
+        inline const dev_page* find_page(word_t addr, word_t size){/*{{{*/
+            const dev_page* dir = page_dir[addr >> (DIR_BITS + PAGE_BITS)].get();
+            if (dir == nullptr) return nullptr;
+            const dev_page* page = &dir[BITS(addr, DIR_BITS + PAGE_BITS - 1, PAGE_BITS)];
+            bool in_page = BITS(addr, PAGE_BITS - 1, 0) + size <= (1u << PAGE_BITS);
+            return (page->dev && in_page) ? page : nullptr;
+        }/*}}}*/
+        void map_pages(const AddrIntv &range, PaddrInterface *dev);
+        bool search_read (word_t addr, wen_t info, word_t* data);
+        bool search_write(word_t addr, wen_t info, const word_t data);
+    public:
+        PaddrTop(el::Logger* input_logger = el::Loggers::getLogger("default"));
+        bool add_dev(AddrIntv &new_range, PaddrInterface *dev);
+        inline bool do_read (word_t addr, wen_t info, word_t* data){/*{{{*/
+            const dev_page* page = find_page(addr, info.size);
+            if (unlikely(page == nullptr)) return search_read(addr, info, data);
+            if (page->pmem) return page->pmem->do_read(addr & page->mask, info, data);
+            return page->dev->do_read(addr & page->mask, info, data);
+        }/*}}}*/
+        inline bool do_write(word_t addr, wen_t info, const word_t data){/*{{{*/
+            const dev_page* page = find_page(addr, info.size);
+            if (unlikely(page == nullptr)) return search_write(addr, info, data);
+            if (page->pmem) return page->pmem->do_write(addr & page->mask, info, data);
+            return page->dev->do_write(addr & page->mask, info, data);
+        }/*}}}*/
+        // one page lookup for the whole burst
+        inline bool burst_read (word_t addr, wen_t info, int len, burst_t burst, uint8_t* data){/*{{{*/
+            word_t bytes = burst == BURST_FIXED ? info.size : info.size * len;
+            word_t base = burst == BURST_WRAP ? addr & ~(bytes - 1) : addr;
+            const dev_page* page = find_page(base, bytes);
+            if (unlikely(page == nullptr)) return PaddrInterface::burst_read(addr, info, len, burst, data);
+            if (page->pmem) return page->pmem->burst_read(addr & page->mask, info, len, burst, data);
+            return page->dev->burst_read(addr & page->mask, info, len, burst, data);
+        }/*}}}*/
+        inline bool burst_write(word_t addr, const wen_t* info, int len, burst_t burst, const uint8_t* data){/*{{{*/
+            word_t bytes = burst == BURST_FIXED ? info[0].size : info[0].size * len;
+            word_t base = burst == BURST_WRAP ? addr & ~(bytes - 1) : addr;
+            const dev_page* page = find_page(base, bytes);
+            if (unlikely(page == nullptr)) return PaddrInterface::burst_write(addr, info, len, burst, data);
+            if (page->pmem) return page->pmem->burst_write(addr & page->mask, info, len, burst, data);
+            return page->dev->burst_write(addr & page->mask, info, len, burst, data);
+        }/*}}}*/
+        void set_logger(el::Logger* input_logger);
+        void set_write_hook(write_hook_t hook);
+        uint8_t* get_host_ptr(word_t addr);
+        struct mem_region {
+            word_t paddr;
+            Pmem* pmem;
+        };
+        // the Pmem devices, one mapping of each host memory (inst_mem of
+        // basic_soc aliases s0_mem)
+        std::vector<mem_region> mem_regions();
+        // state of every device in add_dev() order, see PaddrInterface
+        void save_state(snap_writer& out);
+        bool load_state(snap_reader& in);
+        // the non-zero pages of mem_regions(), loaded only if the memory map
+        // is the same, pages not in the stream are cleared
+        static constexpr size_t MEM_PAGE = 4096;
+        void save_memory(snap_writer& out);
+        bool load_memory(snap_reader& in);
 };/*}}}*/
 
 class output {
@@ -86,6 +297,8 @@ class output {
             thr_empty(false),
             op_log(input_logger) {}
         el::Logger* op_log;
+        void save_output(snap_writer& out){ out.put_queue(uart_queue); out.put(thr_empty); }
+        bool load_output(snap_reader& in){ return in.get_queue(uart_queue) && in.get(thr_empty); }
         void write_buf(uint8_t c){ uart_queue.push(c); thr_empty = false; }
         inline bool exist_tx(){ return !uart_queue.empty(); }
         uint8_t getc(){/*{{{*/
@@ -135,6 +348,11 @@ class PaddrConfreg: public PaddrInterface, public output {/*{{{*/
         bool do_write(word_t addr, wen_t info, const word_t data);
         void set_switch(uint8_t value);
         inline uint32_t get_num() { return num; }
+        inline bool get_open_trace() { return open_trace; }
+        // move the timer as if delta more (or fewer) cycles had passed
+        inline void shift_timer(int64_t delta) { timer += (uint32_t)delta; }
+        void save_state(snap_writer& out);
+        bool load_state(snap_reader& in);
 };/*}}}*/
 
 class Puart8250: public PaddrInterface, public output{/*{{{*/
@@ -148,6 +366,8 @@ class Puart8250: public PaddrInterface, public output{/*{{{*/
             log_pt = input_logger; 
             op_log = input_logger;
         }
+        void save_state(snap_writer& out);
+        bool load_state(snap_reader& in);
         
     public:
         bool DLAB();
@@ -21,14 +21,14 @@
 #define __TEST_BIN__ \
     MUXDEF(CONFIG_TEST_FUNC, __FUNC_BIN__, \
             MUXDEF(CONFIG_TEST_PERF, __PERF_BIN__, \
-                MUXDEF(CONFIG_TEST_SYST, __SYST_BIN__,  \
+                MUXDEF(CONFIG_TEST_SYS, __SYST_BIN__,  \
                     MUXDEF(CONFIG_TEST_UBOOT, __UBOOT_BIN__,\
                         MUXDEF(CONFIG_TEST_LINUX, __LINUX_BIN__, "Non bin")))))
 
 #define __TEST_ELF__ \
     MUXDEF(CONFIG_TEST_FUNC, __FUNC_ELF__, \
             MUXDEF(CONFIG_TEST_PERF, __PERF_ELF__, \
-                MUXDEF(CONFIG_TEST_SYST, __SYST_ELF__,  \
+                MUXDEF(CONFIG_TEST_SYS, __SYST_ELF__,  \
                     MUXDEF(CONFIG_TEST_UBOOT, __UBOOT_ELF__,\
                         MUXDEF(CONFIG_TEST_LINUX, __LINUX_ELF__, "Non elf")))))
 #endif
@@ -0,0 +1,74 @@
+#ifndef __SNAPSHOT_HPP__
+#define __SNAPSHOT_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <type_traits>
+
+/*
+ * Byte stream of a state snapshot: fields are appended in host layout, a
+ * reader takes them back in the same order. Only for plain data; containers
+ * are written as a count and their elements. The reader never runs past
+ * its end, a short stream turns ok() false.
+ */
+class snap_writer {/*{{{*/
+    private:
+        std::string buf;
+    public:
+        inline void put_bytes(const void* data, size_t len) { buf.append((const char*)data, len); }
+        template <typename T>
+        inline void put(const T& v) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot of not plain data");
+            put_bytes(&v, sizeof(T));
+        }
+        template <typename T>
+        void put_queue(std::queue<T> q) {
+            put<uint32_t>(q.size());
+            for (; !q.empty(); q.pop()) put(q.front());
+        }
+        inline const std::string& data() const { return buf; }
+        inline size_t size() const { return buf.size(); }
+        inline void clear() { buf.clear(); }
+};/*}}}*/
+
+class snap_reader {/*{{{*/
+    private:
+        const uint8_t* p;
+        const uint8_t* end;
+        bool good;
+    public:
+        snap_reader(const void* data, size_t len): p((const uint8_t*)data), end(p + len), good(true) {}
+        inline bool get_bytes(void* data, size_t len) {
+            if (len > (size_t)(end - p)) good = false;
+            if (!good) return false;
+            memcpy(data, p, len);
+            p += len;
+            return true;
+        }
+        template <typename T>
+        inline bool get(T& v) {
+            static_assert(std::is_trivially_copyable<T>::value, "snapshot of not plain data");
+            return get_bytes(&v, sizeof(T));
+        }
+        template <typename T>
+        bool get_queue(std::queue<T>& q) {
+            uint32_t n = 0;
+            get(n);
+            q = std::queue<T>();
+            for (T v; good && n; n--) if (get(v)) q.push(v);
+            return good;
+        }
+        // the next len bytes without a copy, nullptr if short
+        inline const uint8_t* take(size_t len) {
+            if (len > (size_t)(end - p)) good = false;
+            if (!good) return nullptr;
+            p += len;
+            return p - len;
+        }
+        inline bool ok() const { return good; }
+        inline size_t left() const { return end - p; }
+};/*}}}*/
+
+#endif
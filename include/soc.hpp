@@ -2,6 +2,7 @@
 #include "paddr/paddr_interface.hpp"
 #include "testbench/sim_state.hpp"
 #include <map>
+#include <string>
 #include <utility>
 #ifndef __SOC_HPP__
 #define __SOC_HPP__
@@ -14,14 +15,50 @@ class dual_soc {/*{{{*/
         inline PaddrTop* get_ref_soc(){ return ptop[REF]; }
 
         void tick();
+#ifdef CONFIG_REF_THREAD
+        // the two halves of tick(), REF on the reference thread
+        void tick_dut();
+        void tick_ref();
+        // compare the output streams, the DUT may be ahead
+        bool check_output();
+        // DLL, DLM, IER, IIR, LCR, MCR, rx empty and thr empty from the low
+        // byte, the uart registers tick() compares
+        IFDEF(CONFIG_HAS_UART, uint64_t uart_regs(soc_who who));
+#endif
         void set_switch(uint8_t value);
         inline uint8_t dut_ext_int() { return ext_int[DUT]; }
         inline uint8_t ref_ext_int() { return ext_int[REF]; }
+        // the number display of MyCPU, where the perference test shows its score
+        IFDEF(CONFIG_HAS_CONFREG, inline uint32_t dut_num() { return pcfreg[DUT]->get_num(); })
+#if defined(CONFIG_GOLDEN_TRACE) || defined(CONFIG_REF_TRACE)
+        // MyCPU without reference, its output is printed and kept in out
+        void tick_dut_alone(std::string* out = nullptr);
+#endif
+#ifdef CONFIG_GOLDEN_TRACE
+        // whether the function test wants its commits compared now
+        inline bool dut_open_trace() { return pcfreg[DUT]->get_open_trace(); }
+#endif
+#ifdef CONFIG_REF_TRACE
+        // the reference alone, its output is dropped
+        void tick_ref_alone();
+        void drop_ref_output();
+        // move the reference timer by delta cycles
+        void shift_ref_time(int64_t delta);
+        // tick() appends the output of the reference it compared
+        inline void set_output_echo(std::string* out) { echo = out; }
+#endif
+#ifdef CONFIG_WAVE_ON
+        // what MyCPU prints is also appended to out, for the wave trigger
+        inline void set_output_watch(std::string* out) { watch = out; }
+#endif
     private:
         PaddrTop*       ptop[2];
         PaddrConfreg*   pcfreg[2];
         Puart8250*      puart[2];
         uint8_t         ext_int[2];
+        IFDEF(CONFIG_REF_THREAD, std::string out[2]);
+        IFDEF(CONFIG_REF_TRACE, std::string* echo);
+        IFDEF(CONFIG_WAVE_ON, std::string* watch);
         bool has_confreg;
         void create_basic_soc();
         void create_boot_soc();
@@ -6,13 +6,8 @@
 #include "generated/autoconf.h"
 #include <memory>
 #include "paddr/paddr_interface.hpp"
+#include "testbench/axi_delay.hpp"
 
-typedef enum {/*{{{*/
-    BURST_FIXED = 0,
-    BURST_INCR  = 1,
-    BURST_WRAP  = 2,
-    BURST_RESERVED  = 3
-}burst_t;/*}}}*/
 typedef enum {/*{{{*/
     RESP_OKEY   = 0,
     RESP_EXOKEY = 1,
@@ -23,7 +18,9 @@ typedef enum {/*{{{*/
 #define AUTO_T(width) \
     typename std::conditional <(width) <=  8, CData, \
     typename std::conditional <(width) <= 16, SData, \
-    typename std::conditional <(width) <= 32, IData, QData >::type >::type >::type
+    typename std::conditional <(width) <= 32, IData, \
+    typename std::conditional <(width) <= 64, QData, VlWide<((width) + 31) / 32> \
+    >::type >::type >::type >::type
 #define  __M_IN__ 1
 #define  __M_OUT__ 0
 #define AXI_BUNDLE(_,...) \
@@ -76,82 +73,87 @@ class axi_paddr{
     private:
         axi_ref pins;
         AXI_BUNDLE(__my_axi_out_def__)
-            uint8_t delay;
+        std::unique_ptr<axi_delay> delay;
+        uint64_t cycle;
     public:
         PaddrTop* paddr_top;
         PaddrTop* check_paddr_top;
         axi_paddr(Vmycpu_top *mycpu, 
                 el::Logger* input_log = el::Loggers::getLogger("default")):
             pins(axi_ref(mycpu)),
-            paddr_top(nullptr) {}
+            paddr_top(nullptr),
+            check_paddr_top(nullptr) {}
+        // reads are compared with diff_mem, none if nullptr
         void set_diff_mem(PaddrTop* diff_mem);
+        void set_delay(std::unique_ptr<axi_delay> model) { delay = std::move(model); }
         bool calculate_output();
         void update_output();
         void reset();
+        // transactions, channel outputs and the latency model
+        void save_state(snap_writer& out);
+        bool load_state(snap_reader& in);
 
     private:
         bool check_axi_req(uint8_t num_bytes, burst_t burst_type, word_t start_addr, uint8_t burst_len);
         typedef enum{/*{{{*/
-            r_idel,     // no transition; arready = 1
-            r_req_ok,   // see arready and arvalid are set in posedge, and delay not end; arready = rvalid = 0;
-            r_wait_last,// delay end and set rvalid but not (rready and rlast); rvalid = 1;
-                        //
-        } rstatus_t;/*}}}*/
-        typedef enum{/*{{{*/
-            w_idel,     // no transition; arready = 1, but wready = 0;
-            w_req_ok,   // wait to accept wdata and info; wready always 1, but if id error sim will stop
-            w_data_ok,  // see wready, wvalid, wlast set in posedge, start delay; bvalid and awready = 0
-            w_wait_back,// delay is end, wait bready to reset; bvalid = 1;
-        } wstatus_t;/*}}}*/
+            t_free,     // slot not used
+            t_req_ok,   // read: accepted, beats not all sent; write: accepted, wait wdata
+            t_data_ok,  // write: all wdata arrived, wait delay then bvalid
+        } tstatus_t;/*}}}*/
+        static constexpr int BUS_BYTES = CONFIG_AXI_DWID / 8;
+        static_assert(BUS_BYTES == 4 || BUS_BYTES == 8 || BUS_BYTES == 16, "AXI data bus is 32, 64 or 128 bits");
+        // one burst; same ID bursts are answered in accept order, others in any order
+        struct axi_txn {/*{{{*/
+            tstatus_t status;
+            uint8_t id;
+            uint64_t seq;       // accept order
+            uint64_t ready_at;  // axi cycle from which the first response may be sent
+            burst_t burst_type;
+            uint8_t burst_count;
+            uint8_t wrap_offset;
+            uint8_t cur_NO;     // beats sent (read) or received (write)
+            bool ok;            // read: the burst read succeeded
+            word_t addr;        // of the first beat
+            wen_t info[16];
+            uint8_t data[16 * BUS_BYTES];   // beat i at i * info[i].size
+        };/*}}}*/
+        static constexpr int NR_TXN = CONFIG_AXI_OUTSTANDING;
+        /*
+         * Byte lane of a beat on the data bus. Beats of a word or less sit in
+         * the lanes of their word, from its low byte, as this model always did
+         * on the 32 bit bus; wider beats sit on their own lanes.
+         */
+        static inline int beat_lane(word_t addr, int size) {
+            return addr & (BUS_BYTES - 1) & ~(std::max(size, 4) - 1);
+        }
 
-        rstatus_t r_status;
-        uint8_t r_burst_count;
-        uint8_t r_left_time;
-        word_t r_wrap_off_mask;
-        word_t r_wrap_bound;
-        uint8_t r_wrap_offset;
-        burst_t r_burst_type;
+        axi_txn r_txn[NR_TXN];
+        uint64_t r_seq;
+        int r_cur;      // txn of the beat on R channel, -1 if none
+        int r_rr;       // last txn picked, round robin
+        axi_txn w_txn[NR_TXN];
+        uint64_t w_seq;
+        int w_back;     // txn of the response on B channel, -1 if none
+        int w_rr;
 
-        word_t r_cur_addr;
-        wen_t r_cur_info;
-        word_t r_cur_data[16];
-        uint8_t r_cur_NO;
-        uint8_t r_cur_id;
+        int free_txn(const axi_txn* txn);
+        int pick_txn(const axi_txn* txn, tstatus_t status, int& rr);
+        void init_txn(axi_txn& t, uint8_t id, uint8_t size_bits, uint8_t len, uint8_t burst, word_t start_addr);
 
         bool accept_read_req();
         bool do_once_read();
         void idel_wait_read();
         bool read_eval();
-        void read_difftest();
-
-        void read_require_trace();
-        void read_data_trace();
-        void write_require_trace();
-        void write_data_trace();
-        void back_trace();
-        
-        wstatus_t w_status;
-        uint8_t w_burst_count;
-        uint8_t w_left_time;
-        word_t w_wrap_off_mask;
-        word_t w_wrap_bound;
-        uint8_t w_wrap_offset;
-        burst_t w_burst_type;
+        void read_difftest(const axi_txn& t);
 
-        word_t w_cur_addr[16];
-        wen_t w_cur_info[16];
-        uint8_t w_cur_id;
-        word_t w_cur_data[16];
-        uint8_t w_cur_NO;
+        void read_data_trace(const axi_txn& t);
+        void write_data_trace(const axi_txn& t);
 
         bool accept_write_req();
         bool accept_write_data();
         bool do_all_write();
         void idel_wait_write();
         bool write_eval();
-
-
-        inline int rand_delay() {return rand()%16+16;}
 };
 
 #endif // !__AXI_HPP__
@@ -0,0 +1,36 @@
+#ifndef __AXI_DELAY_HH__
+#define __AXI_DELAY_HH__
+
+#include "common.hpp"
+#include "snapshot.hpp"
+#include <memory>
+#include <string>
+
+/*
+ * Latency model of the memory behind axi_paddr: cycles from accepting a read
+ * request to the first rdata, or from the last wdata to bvalid. Asked once
+ * per burst with the current axi cycle, len is the number of beats.
+ * Models are made by name, see create(); every model has its own PRNG per
+ * channel, so a run only depends on the seed.
+ */
+class axi_delay {
+    public:
+        virtual ~axi_delay() {}
+        virtual int read_delay(uint64_t now, word_t addr, int len) = 0;
+        virtual int write_delay(uint64_t now, word_t addr, int len) = 0;
+        virtual void reset() {}
+        // bank and PRNG state, for checkpoints of the simulation
+        virtual void save_state(snap_writer& out) {}
+        virtual bool load_state(snap_reader& in) { return true; }
+        /*
+         * spec is "name[:arg...]":
+         *   zero                   no latency, fast functional run
+         *   fixed:N                N cycles
+         *   random:MIN:MAX         uniform in [MIN, MAX]
+         *   ddr:CL:RCD:RP          8 banks of 8KB rows, open page policy
+         * nullptr if spec is not valid
+         */
+        static std::unique_ptr<axi_delay> create(const std::string& spec, uint64_t seed);
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef __COMMIT_SIG_HPP__
+#define __COMMIT_SIG_HPP__
+
+#include "difftest/struct.hpp"
+
+/*
+ * Running signatures of the DUT and NEMU commit streams over a window of
+ * commits. add() only logs and hashes both records, the two signatures are
+ * compared when the window is full; on a mismatch replay() walks the logged
+ * window and finds the first commit that differs.
+ * Records are kept as {pc, wnum, wdata} with wnum = 0 and wdata = 0 when no
+ * general register is written, so both sides must agree on what a write is.
+ * wdata of both keeps only the bytes the DUT wen writes.
+ * The NEMU instruction word is logged too, the mismatch report disassembles
+ * it without reading guest memory again.
+ */
+template <int window>
+class commit_sig {
+    private:
+        static constexpr uint64_t PRIME = 0x100000001b3ull;
+        debug_info_t log[2][window];    // 0: DUT, 1: NEMU
+        word_t inst[window];            // NEMU instruction word
+        uint64_t sig[2];
+        int n;
+        static inline debug_info_t normalize(const debug_info_t& rec, word_t mask) {/*{{{*/
+            uint8_t wnum = rec.wen ? rec.wnum : 0;
+            return (debug_info_t){rec.pc, (unsigned char)(wnum != 0), wnum, wnum ? rec.wdata & mask : 0};
+        }/*}}}*/
+        static inline uint64_t mix(uint64_t h, const debug_info_t& rec) {/*{{{*/
+            h = (h ^ (rec.pc | (uint64_t)rec.wnum << 32)) * PRIME;
+            return (h ^ rec.wdata) * PRIME;
+        }/*}}}*/
+        static inline bool same(const debug_info_t& a, const debug_info_t& b) {
+            return a.pc == b.pc && a.wnum == b.wnum && a.wdata == b.wdata;
+        }
+    public:
+        commit_sig() { reset(); }
+        void reset() { sig[0] = sig[1] = 0; n = 0; }
+        // true if the window is full and must be checked
+        inline bool add(const debug_info_t& dut, const debug_info_t& ref, word_t ref_inst) {/*{{{*/
+            word_t mask = wen_mask(dut.wen);
+            inst[n] = ref_inst;
+            for (int i = 0; i < 2; i++) {
+                debug_info_t rec = normalize(i ? ref : dut, mask);
+                log[i][n] = rec;
+                sig[i] = mix(sig[i], rec);
+            }
+            return ++n == window;
+        }/*}}}*/
+        inline bool agree() const { return sig[0] == sig[1]; }
+        inline int size() const { return n; }
+        // index of the first different commit in the window, -1 if none
+        int replay() const {/*{{{*/
+            for (int i = 0; i < n; i++) {
+                if (!same(log[0][i], log[1][i])) return i;
+            }
+            return -1;
+        }/*}}}*/
+        inline const debug_info_t& dut_at(int i) const { return log[0][i]; }
+        inline const debug_info_t& ref_at(int i) const { return log[1][i]; }
+        inline word_t inst_at(int i) const { return inst[i]; }
+};
+
+#endif
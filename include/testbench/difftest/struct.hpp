@@ -5,11 +5,20 @@
 
 typedef struct{
     word_t pc;
-    unsigned char wen;
+    unsigned char wen;      // byte strobe of wdata, 0 if no general register is written
     unsigned char wnum;
     word_t wdata;
 } debug_info_t;
 
+// the bytes of wdata that wen writes, only they are compared
+static inline word_t wen_mask(unsigned char wen) {/*{{{*/
+    word_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        if (wen >> i & 1) mask |= 0xffu << 8 * i;
+    }
+    return mask;
+}/*}}}*/
+
 typedef struct {
     word_t gpr[32];
     word_t lo,hi;
@@ -18,8 +27,8 @@ typedef struct {
 } diff_state;
 
 typedef struct {
-    unsigned char size: 4;
-    unsigned char wstrb:4;
+    unsigned char size;     // bytes, up to 16 for a 128 bit AXI beat
+    uint16_t wstrb;         // byte enables, bit i for byte i
 } wen_t;
 
 #endif//
@@ -7,9 +7,11 @@ uint32_t dpi_regfile(uint8_t num);
 uint64_t dpi_get_hilo();
 uint8_t dpi_retire();
 uint32_t dpi_retirePC();
+void dpi_get_commit(uint8_t seq, debug_info_t & commit);
 void dpi_get_debug_info0(debug_info_t & debug_info);
 void dpi_get_debug_info1(debug_info_t & debug_info);
 void dpi_api_get_state(diff_state *mycpu);
+void dpi_api_get_commits(debug_info_t *commit, uint8_t commit_num);
 uint8_t dpi_interrupt_seq();
 uint32_t dpi_get_cp0(int rd, int sel);
 bool dpi_is_cp0_change(uint32_t* changed_pc);
@@ -0,0 +1,51 @@
+#ifndef __GOLDEN_TRACE_HPP__
+#define __GOLDEN_TRACE_HPP__
+
+#include "common.hpp"
+#include "testbench/difftest/struct.hpp"
+#include <string>
+
+/*
+ * golden_trace.txt of the NSCSCC function test, lines of
+ * "open_trace pc wnum wdata" in hex, the lines with open_trace 0 are not
+ * compared. It is parsed once into <file>.bin, which is rebuilt when the
+ * size or the modify time of the text changes, and the binary is mapped
+ * read-only, so a run only walks an array.
+ */
+class golden_trace {
+    public:
+        struct rec {
+            word_t pc;
+            word_t wdata;   // bytes not written are 0
+            uint32_t line;  // line in the text, for the report
+            uint8_t wnum;
+            uint8_t pad[3];
+        };
+        struct head {
+            char magic[8];  // "HITDGOLD"
+            uint32_t version;
+            uint32_t count;
+            uint64_t src_size;
+            int64_t src_mtime; // ns
+        };
+    private:
+        std::string name;
+        void* map;
+        size_t map_len;
+        const rec* recs;
+        uint32_t count;
+        uint32_t pos;
+        bool build(const std::string& cache, uint64_t src_size, int64_t src_mtime);
+        bool load(const std::string& cache, uint64_t src_size, int64_t src_mtime);
+    public:
+        golden_trace(): map(nullptr), map_len(0), recs(nullptr), count(0), pos(0) {}
+        ~golden_trace();
+        bool open(const std::string& filename);
+        inline void rewind() { pos = 0; }
+        inline uint32_t size() const { return count; }
+        inline uint32_t checked() const { return pos; }
+        // compare the next record with a commit writing a register
+        bool check(const debug_info_t& commit);
+};
+
+#endif
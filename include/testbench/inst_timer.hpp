@@ -2,31 +2,63 @@
 #define __INST_TIMER__
 #include "common.hpp"
 #include "nemu/cpu/decode.hpp"
-#include "paddr/paddr_interface.hpp"
-#include <memory>
-#include <vector>
+#ifdef CONFIG_PERF_ANALYSES
+#include <string>
+#ifdef CONFIG_PERF_STREAM
+#include "testbench/perf_stream.hpp"
+#else
+#include "testbench/pc_table.hpp"
+#endif
 typedef float       consume_t;
 typedef uint32_t    runtime_t;
-typedef uint32_t    iindex_t;
-class inst_info{
+
+/*
+ * PERF_STREAM: every commit goes to <name>.bin as it happens, a perf_head
+ * then perf_rec records, see tools/mycpu_perf.py.
+ * PERF_HIST: only a histogram per (PC, ASID) is kept and written to
+ * <name>.hist at the end, memory grows with the PCs touched, not the run.
+ * The ASID is 0 for unmapped PCs, so kernel and user code of any SoC can be
+ * told apart.
+ */
+struct perf_head {
+    char magic[8];          // "HITDPERF"
+    uint32_t version;
+    uint32_t rec_size;
+};
+struct perf_rec {
+    word_t pc;              // bit 0 set for a delay slot
+    uint32_t ticks;         // low 32 bits
+    consume_t consume;      // cycles
+    uint32_t asid;
+};
+
+class inst_hist {
     public:
+        // bucket 0: < 1 cycle, bucket i: [2^(i-1), 2^i) cycles, the last one open
+        static constexpr int NR_BUCKET = 16;
         bool        is_enter;
         runtime_t   runtime;
-        consume_t   consume;
-        std::vector<std::tuple<uint64_t, consume_t>> verbose;
-        inst_info(): is_enter(false), runtime(0), consume(0) {}
+        double      sum;
+        consume_t   min, max;
+        runtime_t   bucket[NR_BUCKET];
+        inst_hist(): is_enter(false), runtime(0), sum(0), min(0), max(0), bucket{} {}
+        void add(consume_t cycles);
 };
+
 class inst_timer {
     public:
-    inst_timer(AddrIntv _range);
-    void add_inst(Decode& inst_state, consume_t consumed_time, uint64_t ticks);
-    bool save_date(std::string filename);
+    // records are written to filename + ".bin" or ".hist"
+    inst_timer(std::string filename);
+    void add_inst(Decode& inst_state, uint8_t asid, consume_t consumed_time, uint64_t ticks);
+    bool save_date();
 
     private:
-    word_t mask;
-    iindex_t item_nr;
-    std::unique_ptr<inst_info[]> data;
-    inline iindex_t pc2index(word_t pc){return (pc & mask) >> 2;}
-    inline word_t index2pc(iindex_t index){return ((index<<2)|0x9fc00000); }
+    std::string name;
+#ifdef CONFIG_PERF_STREAM
+    perf_stream out;
+#else
+    pc_table<inst_hist> hist;
+#endif
 };
+#endif
 #endif // !__INST_TIMER__
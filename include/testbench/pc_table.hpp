@@ -0,0 +1,80 @@
+#ifndef __PC_TABLE_HPP__
+#define __PC_TABLE_HPP__
+
+#include "common.hpp"
+#include <vector>
+
+/*
+ * (PC, ASID) -> T for any address space. Open addressing with linear probing
+ * over 64 byte lines of code: a group holds the 16 PCs of one line of one
+ * ASID, so a run of instructions stays in one group and most lookups are a
+ * single compare. The values and their keys are kept flat in insertion order;
+ * memory only grows with the lines touched and a walk over the values is
+ * sequential.
+ * Unmapped PCs (kseg0/kseg1) should use ASID 0.
+ */
+template <typename T>
+class pc_table {
+    private:
+        static constexpr uint32_t NO_ASID = 0x100;  // empty group
+        static constexpr uint32_t MAX_SIZE = 1u << 31;
+        struct group {
+            word_t line;        // pc >> 6
+            uint32_t asid;
+            uint32_t ref[16];   // index + 1 of the value of each PC, 0 if none
+        };
+        struct key_t {
+            word_t pc;
+            uint8_t asid;
+        };
+        std::vector<group> groups;      // 2 power, at most half used
+        uint32_t used;
+        std::vector<T> values;
+        std::vector<key_t> keys;
+        static inline uint32_t hash(word_t line, uint8_t asid) {
+            return ((uint64_t)line << 8 | asid) * 0x9e3779b97f4a7c15ull >> 32;
+        }
+        // the group of (line, asid), or the empty one to take for it
+        inline group& find(word_t line, uint8_t asid) {/*{{{*/
+            uint32_t mask = groups.size() - 1;
+            uint32_t h = hash(line, asid) & mask;
+            while (groups[h].asid != NO_ASID && (groups[h].line != line || groups[h].asid != asid)) h = (h + 1) & mask;
+            return groups[h];
+        }/*}}}*/
+        void grow() {/*{{{*/
+            std::vector<group> old(groups.size() * 2, empty());
+            old.swap(groups);
+            for (const group& g: old) {
+                if (g.asid != NO_ASID) find(g.line, g.asid) = g;
+            }
+        }/*}}}*/
+        static inline group empty() { return group{0, NO_ASID, {}}; }
+    public:
+        // capacity: initial number of groups, 2 power
+        pc_table(uint32_t capacity = 1 << 10): groups(capacity, empty()), used(0) {}
+        // the value of (pc, asid), inserted as T() if new
+        inline T& at(word_t pc, uint8_t asid) {/*{{{*/
+            group* g = &find(pc >> 6, asid);
+            uint32_t& ref = g->ref[BITS(pc, 5, 2)];
+            if (likely(ref)) return values[ref - 1];
+            Assert(values.size() < MAX_SIZE, "pc_table holds at most %u PCs", MAX_SIZE);
+            if (g->asid == NO_ASID) {
+                if (2 * (used + 1) > groups.size()) {
+                    grow();
+                    g = &find(pc >> 6, asid);
+                }
+                *g = group{pc >> 6, asid, {}};
+                used++;
+            }
+            keys.push_back({pc, asid});
+            values.emplace_back();
+            g->ref[BITS(pc, 5, 2)] = values.size();
+            return values.back();
+        }/*}}}*/
+        inline size_t size() const { return values.size(); }
+        inline word_t pc_at(size_t i) const { return keys[i].pc; }
+        inline uint8_t asid_at(size_t i) const { return keys[i].asid; }
+        inline const T& value_at(size_t i) const { return values[i]; }
+};
+
+#endif
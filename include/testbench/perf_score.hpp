@@ -0,0 +1,48 @@
+#ifndef __PERF_SCORE_HPP__
+#define __PERF_SCORE_HPP__
+
+#include "common.hpp"
+#include <string>
+#include <vector>
+
+// what a perference test program leaves
+struct perf_result {
+    uint32_t program;
+    bool pass;
+    uint64_t cycles;    // the whole run, reset and loading included
+    uint32_t num;       // number display of the confreg, the score of the program
+    double seconds;
+};
+
+/*
+ * NSCSCC performance score. A perference test program shows on the number
+ * display how many confreg timer ticks its benchmark takes; the ratio of a
+ * program is the count of the reference CPU (gs132) over this count and the
+ * score is the geometric mean of the ratios. The confreg timer ticks once a
+ * MyCPU cycle here, so this is the score at the clock of the reference.
+ * A baseline is the csv of an earlier run; the counts of its passed programs
+ * are compared with this run.
+ */
+class perf_score {
+    private:
+        struct row {
+            perf_result res;
+            double ratio;       // 0 if failed
+            uint32_t base;      // count of the baseline, 0 if none
+        };
+        std::vector<row> rows;
+        std::string baseline;
+        // geometric mean of the ratios of the passed programs, of the ones
+        // the baseline also passed if common, with the baseline counts if base
+        double geo_mean(bool common, bool base) const;
+    public:
+        perf_score(const std::vector<perf_result>& results);
+        static const char* name(uint32_t program);
+        bool load_baseline(const std::string& filename);
+        // logs the table of every program and the score
+        void report(int jobs, double seconds) const;
+        // writes prefix.json and prefix.csv
+        bool save(const std::string& prefix) const;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __PERF_STREAM_HPP__
+#define __PERF_STREAM_HPP__
+
+#include "common.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Append-only binary file written through two fixed buffers. put() only
+ * copies into the current buffer; a full buffer is handed to a writer thread
+ * and the simulation goes on with the other one, it only waits when the
+ * writer is still busy with the previous buffer.
+ * Every handed buffer is write(2) to the file as a whole; a reader drops a
+ * partial record at the end. A run stopped by a mismatch or Ctrl-C still
+ * reaches close(), so nothing is lost. If the process dies instead (a failed
+ * assert, a fatal signal), the loss is bounded: the buffer being filled and
+ * the one the writer holds, at most 2 * buf_size bytes of the last records.
+ */
+class perf_stream {
+    private:
+        size_t buf_size;
+        std::unique_ptr<uint8_t[]> buf[2];
+        int cur;
+        size_t used;
+        int fd;
+        bool failed;
+        // shared with the writer thread
+        std::thread writer;
+        std::mutex lock;
+        std::condition_variable cv;
+        int pending;        // buffer to write, -1 if none
+        size_t pending_len;
+        bool quit;
+        void run();
+        void handoff();
+    public:
+        perf_stream(size_t _buf_size): buf_size(_buf_size), cur(0), used(0), fd(-1), failed(false),
+            pending(-1), pending_len(0), quit(false) {}
+        ~perf_stream() { close(); }
+        // truncates filename and writes head synchronously
+        bool open(const std::string& filename, const void* head, size_t len);
+        inline void put(const void* data, size_t len) {/*{{{*/
+            if (unlikely(used + len > buf_size)) handoff();
+            memcpy(buf[cur].get() + used, data, len);
+            used += len;
+        }/*}}}*/
+        // writes what is buffered and joins the writer, false if any write failed
+        bool close();
+};
+
+#endif
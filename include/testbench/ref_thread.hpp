@@ -0,0 +1,60 @@
+#ifndef __REF_THREAD_HPP__
+#define __REF_THREAD_HPP__
+
+#include "difftest/struct.hpp"
+#include "testbench/spsc_ring.hpp"
+#include "soc.hpp"
+#include <atomic>
+#include <thread>
+
+// one DUT clock cycle with commits
+struct commit_record {
+    uint64_t ticks;     // of the commit, for the mismatch report
+    uint64_t cycle;     // posedges since reset, the reference ticks up to it
+    uint8_t commit_num; // 0: end of simulation
+    uint8_t int_seq;    // dpi_interrupt_seq()
+    uint8_t ext_int;    // dut_ext_int() of the cycle
+    uint64_t uart;      // uart_regs(DUT) of the cycle, 0 without a uart
+    diff_state state;   // DUT state after the commits
+#ifdef CONFIG_COMMIT_DIFF
+    bool full_diff;     // state is valid, else only commit is checked
+    debug_info_t commit[CONFIG_COMMIT_WIDTH];
+#endif
+};
+
+/*
+ * Reference NEMU and its SoC on their own thread. mainloop() pushes a record
+ * for every cycle with commits, the thread replays the SoC and CP0 ticks up
+ * to that cycle, compares the interrupt lines and uart registers of the two
+ * SoCs, executes the commits and compares the state. It stops at the first
+ * mismatch or when NEMU quits; only then may the DUT thread touch nemu.
+ * Nothing feeds the uart rx here: a host input would reach the two SoCs at
+ * different cycles, it has to be given to REF at the cycle of a record.
+ */
+class ref_thread {
+    public:
+        enum result_t { REF_RUNNING, REF_DONE, REF_MISMATCH, REF_UART_MISMATCH, REF_QUIT };
+    private:
+        spsc_ring<commit_record, CONFIG_REF_RING_SIZE> ring;
+        std::thread worker;
+        dual_soc& soc;
+        uint64_t cycle;
+        std::atomic<result_t> result;
+        commit_record failed;
+        IFDEF(CONFIG_COMMIT_DIFF, int failed_seq = -1);
+        void run();
+        result_t check(const commit_record& rec);
+    public:
+        ref_thread(dual_soc& _soc): soc(_soc), cycle(0), result(REF_RUNNING) {}
+        void start() { worker = std::thread(&ref_thread::run, this); }
+        // spins while the ring is full, drops rec once the thread stopped
+        void push(const commit_record& rec);
+        inline bool stopped() { return result.load(std::memory_order_relaxed) != REF_RUNNING; }
+        // check what is left in the ring and join
+        result_t finish();
+        inline const commit_record& failed_record() const { return failed; }
+        // the commit of failed_record() that mismatched, -1 if the state did
+        IFDEF(CONFIG_COMMIT_DIFF, inline int failed_commit() const { return failed_seq; })
+};
+
+#endif
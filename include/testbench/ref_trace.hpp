@@ -0,0 +1,130 @@
+#ifndef __REF_TRACE_HPP__
+#define __REF_TRACE_HPP__
+
+#include "common.hpp"
+#include "soc.hpp"
+#include "snapshot.hpp"
+#include "testbench/difftest/struct.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Commit stream of nemu recorded by one run and checked by later runs of the
+ * same program. The file is a head, chunks of REF_TRACE_CHUNK commits, an
+ * index of the chunk offsets and a tail. A chunk starts with the checkpoint
+ * taken before its first commit: the memory pages changed since the previous
+ * checkpoint (all non-zero pages for the first), nemu and the devices of its
+ * SoC. Its records and the output of the SoC follow, the two parts are
+ * compressed apart so a restore does not inflate the records of old chunks.
+ *
+ * Replaying keeps the register file in a shadow, checks each DUT commit as
+ * ref_check_commit() does and the whole regfile as ref_checkregs() does. On
+ * the first difference take_over() restores the checkpoint of the current
+ * chunk, runs nemu over the commits of the chunk already checked and moves
+ * its timers to the cycle of the DUT; nemu then goes on as in a normal run.
+ */
+class ref_trace {
+    public:
+        struct rec {
+            word_t pc;
+            word_t wdata;       // gpr[wnum] after the commit
+            word_t hi;
+            word_t lo;
+            uint32_t cycle;     // cycles since the previous commit
+            uint8_t wnum;
+            uint8_t flag;
+            uint16_t pad;
+        };
+        enum : uint8_t {
+            REC_INT   = 1,      // the DUT took an interrupt here
+            REC_SKIP  = 2,      // nemu took wdata from the DUT (mfc0 count)
+            REC_EXC   = 4,      // entered an exception
+            REC_HILO  = 8,      // hi and lo are valid
+            REC_END   = 16,     // nemu reached the end, not a commit
+            REC_ABORT = 32,     // nemu aborted, not a commit
+        };
+        struct file_head {
+            char magic[8];      // "HITDREFT"
+            uint32_t version;
+            uint32_t rec_size;
+            uint32_t bin_crc;   // of the test binary
+            uint32_t pad;
+        };
+        struct chunk_head {
+            uint64_t first_seq;
+            uint64_t first_cycle;   // nemu ticks before the first commit
+            uint32_t nr_rec;
+            uint32_t out_len;
+            uint32_t state_len;
+            uint32_t state_zlen;
+            uint32_t data_len;      // records and output
+            uint32_t data_zlen;
+        };
+        struct file_tail {
+            uint64_t index_offset;
+            uint64_t nr_rec;
+            uint32_t nr_chunk;
+            uint32_t pad;
+            char magic[8];      // "HITDREND"
+        };
+        enum result_t { TRACE_OK, TRACE_END, TRACE_MISS };
+    private:
+        dual_soc& soc;
+        std::string name;
+        std::vector<rec> recs;      // of the chunk being recorded or replayed
+        std::string ref_out;        // output of the reference SoC, in the chunk or all loaded
+        uint64_t seq;               // commits recorded or checked
+        // recording
+        FILE* fp;
+        chunk_head cur;
+        snap_writer state;
+        std::vector<uint64_t> index;
+        std::vector<std::unique_ptr<uint8_t[]>> shadow;   // memory at the last checkpoint
+        uint64_t last_cycle;
+        bool exl;
+        void checkpoint(uint64_t cycle);
+        bool write_chunk();
+        // replaying
+        void* map;
+        size_t map_len;
+        const file_tail* tail;
+        const uint64_t* chunk_off;
+        uint32_t chunk;
+        uint32_t pos;               // in recs
+        bool replay;
+        word_t gpr[32];
+        word_t last_pc;
+        word_t hi, lo;
+        bool hilo;
+        std::vector<std::pair<uint32_t, word_t>> skips;  // DUT wdata of REC_SKIP records in the chunk
+        std::string dut_out;
+        size_t out_checked;
+        bool load_chunk(uint32_t c);
+        bool inflate_part(uint32_t c, const uint8_t* src, uint32_t zlen, uint32_t len, std::string& dst);
+        bool restore();
+    public:
+        ref_trace(dual_soc& soc_input);
+        ~ref_trace();
+        // recording, the calls do nothing if no file is created
+        bool create(const std::string& filename);
+        void before_exec(uint64_t cycle);
+        // after nemu_exec_once() and the skip fix, mycpu_int as it was given
+        void record(uint64_t cycle, bool mycpu_int);
+        // replaying
+        bool open(const std::string& filename);
+        inline bool replaying() const { return replay; }
+        result_t check(const debug_info_t& commit, bool mycpu_int);
+        bool check_regs(const diff_state* mycpu);
+        inline std::string* dut_output() { return &dut_out; }
+        // compare the new output of the DUT, at the end it must be complete
+        bool check_output(bool end);
+        // nemu state of the REC_END or REC_ABORT record
+        int end_state() const;
+        // nemu takes the place of the trace at this cycle
+        bool take_over(uint64_t cycle);
+        // close the recording, report the replay
+        void finish();
+};
+
+#endif
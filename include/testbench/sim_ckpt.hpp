@@ -0,0 +1,47 @@
+#ifndef __SIM_CKPT_HPP__
+#define __SIM_CKPT_HPP__
+
+#include "Vmycpu_top.h"
+#include "soc.hpp"
+#include "testbench/axi.hpp"
+#include <string>
+#include <vector>
+
+/*
+ * Checkpoints of the whole simulation: the model of MyCPU (Verilator
+ * --savable), axi_paddr, both SoCs with their memory, nemu and the counters
+ * of the main loop given to keep(). They go every SIM_CKPT_PERIOD cycles
+ * into a ring of SIM_CKPT_NR files SIM_CKPT_DIR/<wave name>.ckpt.<slot>;
+ * each file is written aside and renamed, so every slot is whole.
+ */
+class sim_ckpt {
+    public:
+        struct head {
+            char magic[8];          // "HITDSIMC"
+            uint32_t version;
+            uint32_t nr_keep;
+            uint64_t ticks;
+            uint64_t seq;           // checkpoints taken before this one
+            uint32_t state_len;
+            uint32_t state_zlen;
+        };
+    private:
+        Vmycpu_top* top;
+        axi_paddr* axi;
+        dual_soc& soc;
+        std::string base;
+        std::vector<uint64_t*> kept;
+        uint64_t seq;
+        std::string slot_name(uint32_t slot) const;
+        bool read_head(const std::string& filename, head& h);
+    public:
+        sim_ckpt(Vmycpu_top* top_input, axi_paddr* axi_input, dual_soc& soc_input, const std::string& wave_name);
+        // a counter of the main loop, saved and restored with the rest
+        inline void keep(uint64_t& var) { kept.push_back(&var); }
+        inline bool due(uint64_t ticks) const { return ticks % (2 * (uint64_t)CONFIG_SIM_CKPT_PERIOD) == 0; }
+        bool save(uint64_t ticks);
+        // the newest checkpoint but age, nothing changes if there is none
+        bool restore(uint32_t age);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef __SIM_PROF_HPP__
+#define __SIM_PROF_HPP__
+
+#include "common.hpp"
+#include <chrono>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Host time of the phases of mainloop(). lap(p) charges the time since the
+ * previous lap to phase p, one time stamp per phase boundary; time stamps
+ * are rdtsc where there is one and are converted to seconds with the wall
+ * clock of the whole run. cycle() counts DUT cycles and commits and logs
+ * the simulation speed every CONFIG_SIM_PROF_PERIOD seconds.
+ */
+class sim_prof {
+    public:
+        enum phase_t { PH_EVAL, PH_AXI, PH_SOC, PH_NEMU, PH_CHECK, PH_WAVE, PH_OTHER, NR_PHASE };
+    private:
+        typedef std::chrono::steady_clock clock;
+        uint64_t acc[NR_PHASE];
+        uint64_t last;
+        uint64_t cycles, commits;
+        uint64_t start_stamp;
+        clock::time_point start_time;
+        // the last report
+        uint64_t report_cycles, report_commits;
+        clock::time_point report_time;
+        static inline uint64_t stamp() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return clock::now().time_since_epoch().count();
+#endif
+        }
+        void report();
+    public:
+        sim_prof() { start(); }
+        void start();
+        inline void lap(phase_t p) {/*{{{*/
+            uint64_t now = stamp();
+            acc[p] += now - last;
+            last = now;
+        }/*}}}*/
+        inline void cycle(uint8_t commit_num) {/*{{{*/
+            commits += commit_num;
+            if (unlikely((++cycles & 0xffff) == 0)) report();
+        }/*}}}*/
+        // logs the summary table and writes it to filename as JSON
+        void finish(const std::string& filename);
+};
+
+#endif
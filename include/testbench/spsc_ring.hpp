@@ -0,0 +1,46 @@
+#ifndef __SPSC_RING_HPP__
+#define __SPSC_RING_HPP__
+
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Lock-free ring between one producer and one consumer thread. Each side
+ * caches the other's index and only reloads it when the ring looks full or
+ * empty, so the shared cache lines move once per batch, not per element.
+ */
+template <typename T, size_t N>
+class spsc_ring {
+    static_assert((N & (N - 1)) == 0, "spsc_ring size is not 2 power");
+    private:
+        static constexpr size_t LINE = 64;
+        T buf[N];
+        alignas(LINE) std::atomic<size_t> head{0};  // next to pop
+        size_t tail_cache = 0;                      // consumer's view of tail
+        alignas(LINE) std::atomic<size_t> tail{0};  // next to push
+        size_t head_cache = 0;                      // producer's view of head
+    public:
+        // producer side, false if full
+        inline bool try_push(const T& v) {/*{{{*/
+            size_t t = tail.load(std::memory_order_relaxed);
+            if (t - head_cache == N) {
+                head_cache = head.load(std::memory_order_acquire);
+                if (t - head_cache == N) return false;
+            }
+            buf[t & (N - 1)] = v;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }/*}}}*/
+        // consumer side, nullptr if empty; the element stays valid until pop()
+        inline const T* front() {/*{{{*/
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail_cache) {
+                tail_cache = tail.load(std::memory_order_acquire);
+                if (h == tail_cache) return nullptr;
+            }
+            return &buf[h & (N - 1)];
+        }/*}}}*/
+        inline void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __WAVE_CTL_HPP__
+#define __WAVE_CTL_HPP__
+
+#include "common.hpp"
+#include "Vmycpu_top.h"
+#include <string>
+#include <vector>
+
+#define wave_file_t MUXDEF(CONFIG_EXT_FST,VerilatedFstC,VerilatedVcdC)
+#define __WAVE_INC__ MUXDEF(CONFIG_EXT_FST,"verilated_fst_c.h","verilated_vcd_c.h")
+#include __WAVE_INC__
+
+/*
+ * Which edges of MyCPU go to the wave. Without a condition it is every edge
+ * from reset, --wave=COND[,COND...] dumps only after a trigger:
+ *   tick:A[-B]     the ticks A to B
+ *   pc:ADDR[+N]    N ticks from the first retire of ADDR
+ *   uart:TEXT[+N]  N ticks from when MyCPU has printed TEXT
+ *   fail[:N]       keep only the last N ticks before a failure
+ * The file is opened by the first trigger and keeps its gaps. With fail the
+ * wave rotates between <wave name>.0 and .1 every N ticks, so the two keep
+ * N to 2N ticks, and both are removed when the test passes.
+ */
+class wave_ctl {
+    public:
+        enum kind_t { TRIG_TICK, TRIG_PC, TRIG_UART };
+        struct trigger {
+            kind_t kind;
+            bool fired;
+            uint64_t from;      // TRIG_TICK
+            uint64_t len;       // ticks dumped from the trigger
+            word_t pc;          // TRIG_PC
+            std::string text;   // TRIG_UART
+        };
+    private:
+        wave_file_t tfp;
+        std::string base;
+        std::vector<trigger> trig;
+        bool valid;
+        bool opened;
+        bool dumping;
+        bool pc_trig;
+        uint64_t until;         // the last tick of this dump
+        uint64_t next;          // the next tick a tick trigger fires or the dump stops
+        uint64_t window;        // 0 without fail
+        uint64_t seg_start;
+        uint32_t seg;
+        std::string output;     // what MyCPU printed, with a uart trigger
+        size_t scanned;
+        bool parse(const char* spec);
+        std::string file_name(int32_t segment) const;
+        void start(uint64_t ticks, uint64_t len, const char* why);
+        void update(uint64_t ticks);
+        void rotate(uint64_t ticks);
+        void plan();
+    public:
+        // from_reset: without a condition the wave starts at reset
+        wave_ctl(Vmycpu_top* top, const std::string& wave_name, const char* spec, bool from_reset);
+        inline bool ok() const { return valid; }
+        // where the SoC appends the output of MyCPU, nullptr without a uart trigger
+        std::string* output_watch();
+        inline bool watch_pc() const { return pc_trig; }
+        void retire(word_t pc, uint64_t ticks);
+        inline void dump(uint64_t ticks) {
+            if (unlikely(ticks >= next || output.size() != scanned)) update(ticks);
+            if (dumping) {
+                if (window && ticks - seg_start >= window) rotate(ticks);
+                tfp.dump(ticks);
+            }
+        }
+        // closes the wave, a passed test drops the window kept for a failure
+        void finish(bool failed);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __TLB_INDEX_HH__
+#define __TLB_INDEX_HH__
+
+#include "common.hpp"
+
+/*
+ * VPN2 -> TLB entry index, shared by NEMU and CEMU. Every bucket holds a
+ * bitmap of the entries hashed to it, so a lookup only compares the entries
+ * with the same hash, whatever the TLB size. The owner calls set() whenever
+ * an entry changes (tlbwi/tlbwr); the key copy here keeps lookups away from
+ * the bit fields of the entries.
+ * Like a scan from entry 0, the lowest matching index wins.
+ */
+template <int nr_tlb_entry>
+class tlb_index {
+    private:
+        static_assert(nr_tlb_entry <= 64, "tlb_index holds at most 64 entries");
+        static constexpr int NR_BUCKET = 256;
+        struct tlb_key {
+            word_t vpn2;
+            uint8_t asid;
+            bool g;
+        };
+        tlb_key key[nr_tlb_entry];
+        uint64_t bucket[NR_BUCKET];
+        static inline int hash(word_t vpn2) { return (vpn2 ^ (vpn2 >> 8)) & (NR_BUCKET - 1); }
+    public:
+        // all entries are {vpn2 = 0, asid = 0, g = 0}, as a zeroed TLB
+        tlb_index() { reset(); }
+        void reset() {/*{{{*/
+            memset(key, 0, sizeof(key));
+            memset(bucket, 0, sizeof(bucket));
+            bucket[hash(0)] = ~0ull >> (64 - nr_tlb_entry);
+        }/*}}}*/
+        void set(int idx, word_t vpn2, uint8_t asid, bool g) {/*{{{*/
+            bucket[hash(key[idx].vpn2)] &= ~(1ull << idx);
+            key[idx] = {vpn2, asid, g};
+            bucket[hash(vpn2)] |= 1ull << idx;
+        }/*}}}*/
+        // index of the entry matching (vpn2, asid), -1 if none
+        inline int match(word_t vpn2, uint8_t asid) const {/*{{{*/
+            for (uint64_t m = bucket[hash(vpn2)]; m; m &= m - 1) {
+                int idx = __builtin_ctzll(m);
+                const tlb_key& k = key[idx];
+                if (k.vpn2 == vpn2 && (k.g || k.asid == asid)) return idx;
+            }
+            return -1;
+        }/*}}}*/
+};
+
+#endif
@@ -5,6 +5,10 @@ CFLAGS_BUILD += $(if $(CONFIG_CC_DEBUG),,$(call remove_quote,$(CONFIG_CC_OPT)))
 CFLAGS_BUILD += $(if $(CONFIG_CC_LTO),-flto,)
 CFLAGS_BUILD += $(if $(CONFIG_CC_DEBUG),-Og -ggdb3,)
 CFLAGS_BUILD += $(if $(CONFIG_CC_ASAN),-fsanitize=address,)
+CFLAGS_BUILD += $(if $(CONFIG_REF_THREAD),-pthread -DELPP_THREAD_SAFE,)
+CFLAGS_BUILD += $(if $(CONFIG_PERF_STREAM),-pthread,)
+LIBS += $(if $(CONFIG_REF_THREAD)$(CONFIG_PERF_STREAM),-pthread,)
+LIBS += $(if $(CONFIG_REF_TRACE)$(CONFIG_SIM_CKPT),-lz,)
 NAME = Vmycpu_top
 WORK_DIR  := $(HITD_HOME)
 BUILD_DIR := $(WORK_DIR)/build
@@ -115,7 +119,7 @@ $(BINARY): $(OBJ_ALL) $(ELFIN_AR)
 endif
 
 # Some convenient rules
-.PHONY: elf gdb sim
+.PHONY: elf gdb sim smc-test
 
 LOG_FILE = 	$(call remove_quote, $(CONFIG_TRACE_FILE))
 LOG_DIR  = 	$(dir $(LOG_FILE))
@@ -146,6 +150,14 @@ gdb: elf
 log:
 	cat $(LOG_FILE)
 
+# overwrite executed code and check nemu runs the new code, see tools/smc-test
+smc-test: elf
+ifeq ($(CONFIG_NSC_NEMU)$(CONFIG_TEST_UBOOT)$(CONFIG_MIPS_RLS1)$(CONFIG_DIFFTEST),yyy)
+	$(MAKE) -C tools/smc-test run NEMU=$(BINARY)
+else
+	$(error smc-test needs NSC_NEMU, TEST_UBOOT and MIPS_RLS1 without DIFFTEST)
+endif
+
 clean:
 	rm -rf $(BUILD_DIR)
 ifdef CONFIG_TRACE
@@ -32,7 +32,9 @@ VXXFLAGS += -LDFLAGS "$(LIBS)"
 
 ifdef CONFIG_WAVE_ON
 	VXXFLAGS += --trace$(if $(CONFIG_EXT_FST),-fst)
+	VXXFLAGS += $(if $(filter-out 0,$(CONFIG_WAVE_THREADS)),--trace-threads $(CONFIG_WAVE_THREADS))
 endif
+VXXFLAGS += $(if $(CONFIG_SIM_CKPT),--savable)
 
 VSRC_TOP := $(VSRC_HOME)/$(TOP_NAME).v
 VSRC_ALL := $(shell find -L $(VSRC_HOME) -type f -name "*.v")
@@ -211,3 +211,37 @@ void PaddrConfreg::set_switch(uint8_t value) {/*{{{*/
         }
     }
 }/*}}}*/
+
+void PaddrConfreg::save_state(snap_writer& out) {/*{{{*/
+    out.put(cr);
+    out.put(switch_data);
+    out.put(switch_inter_data);
+    out.put(timer);
+    out.put(led);
+    out.put(led_rg0);
+    out.put(led_rg1);
+    out.put(num);
+    out.put(simu_flag);
+    out.put(io_simu);
+    out.put(virtual_uart);
+    out.put(open_trace);
+    out.put(num_monitor);
+    save_output(out);
+}/*}}}*/
+
+bool PaddrConfreg::load_state(snap_reader& in) {/*{{{*/
+    in.get(cr);
+    in.get(switch_data);
+    in.get(switch_inter_data);
+    in.get(timer);
+    in.get(led);
+    in.get(led_rg0);
+    in.get(led_rg1);
+    in.get(num);
+    in.get(simu_flag);
+    in.get(io_simu);
+    in.get(virtual_uart);
+    in.get(open_trace);
+    in.get(num_monitor);
+    return load_output(in);
+}/*}}}*/
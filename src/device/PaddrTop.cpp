@@ -2,6 +2,7 @@
 #include "paddr/paddr_interface.hpp"
 #include "debug.hpp"
 #include "fmt/core.h"
+#include <algorithm>
 #include <utility>
 
 PaddrTop::PaddrTop(el::Logger* input_logger):
@@ -9,7 +10,7 @@ PaddrInterface(input_logger) { devices.clear(); };
 
 bool PaddrTop::add_dev(AddrIntv &new_range, PaddrInterface *dev) {
     // check overlap
-    for (auto it: devices){
+    for (auto &it: devices){
         AddrIntv old_range = it.first;
         word_t l_max = std::max(old_range.start,new_range.start);
         word_t r_min = std::min(old_range.end(),new_range.end());
@@ -17,10 +18,24 @@ bool PaddrTop::add_dev(AddrIntv &new_range, PaddrInterface *dev) {
     }
     devices.push_back(std::make_pair(new_range, dev));
     dev->log_pt = log_pt;
+    map_pages(new_range, dev);
     return true;
 }
-bool PaddrTop::do_read (word_t addr, wen_t info, word_t* data){
-    for (auto it: devices){
+
+void PaddrTop::map_pages(const AddrIntv &range, PaddrInterface *dev){/*{{{*/
+    // devices smaller than a page are left to search_read/search_write
+    if (range.mask < BITMASK(PAGE_BITS)) return;
+    Pmem* pmem = dynamic_cast<Pmem*>(dev);
+    uint64_t end = (uint64_t)range.start + range.mask + 1;
+    for (uint64_t addr = range.start; addr < end; addr += 1u << PAGE_BITS) {
+        auto &dir = page_dir[addr >> (DIR_BITS + PAGE_BITS)];
+        if (!dir) dir.reset(new dev_page[1 << DIR_BITS]());
+        dir[BITS(addr, DIR_BITS + PAGE_BITS - 1, PAGE_BITS)] = {dev, pmem, range.mask};
+    }
+}/*}}}*/
+
+bool PaddrTop::search_read (word_t addr, wen_t info, word_t* data){
+    for (auto &it: devices){
         AddrIntv dev_range = it.first;
         if (dev_range.start<=addr && (addr+info.size-1)<=dev_range.end()){
             return it.second->do_read(addr & dev_range.mask, info, data);
@@ -32,13 +47,31 @@ bool PaddrTop::do_read (word_t addr, wen_t info, word_t* data){
 
 void PaddrTop::set_logger(el::Logger *input_logger){
     log_pt = input_logger;
-    for (auto it: devices){
+    for (auto &it: devices){
         it.second->set_logger(input_logger);
     }
 }
 
-bool PaddrTop::do_write(word_t addr, wen_t info, const word_t data){
-    for (auto it: devices){
+void PaddrTop::set_write_hook(write_hook_t hook){
+    for (auto &it: devices){
+        it.second->set_write_hook(hook);
+    }
+}
+
+uint8_t* PaddrTop::get_host_ptr(word_t addr){
+    const dev_page* page = find_page(addr, 1);
+    if (page) return page->pmem ? page->pmem->get_host_ptr(addr & page->mask) : nullptr;
+    for (auto &it: devices){
+        AddrIntv dev_range = it.first;
+        if (dev_range.start<=addr && addr<=dev_range.end()){
+            return it.second->get_host_ptr(addr & dev_range.mask);
+        }
+    }
+    return nullptr;
+}
+
+bool PaddrTop::search_write(word_t addr, wen_t info, const word_t data){
+    for (auto &it: devices){
         AddrIntv dev_range = it.first;
         if (dev_range.start<=addr && (addr+info.size-1)<=dev_range.end()){
             return it.second->do_write(addr & dev_range.mask, info, data);
@@ -47,3 +80,79 @@ bool PaddrTop::do_write(word_t addr, wen_t info, const word_t data){
     log_pt->error(fmt::format("write addr " HEX_WORD " {} bytes out of bound", addr, (uint8_t)info.size));
     return false;
 }
+
+std::vector<PaddrTop::mem_region> PaddrTop::mem_regions(){/*{{{*/
+    std::vector<mem_region> res;
+    for (auto &it: devices){
+        Pmem* pmem = dynamic_cast<Pmem*>(it.second);
+        if (pmem == nullptr) continue;
+        uint8_t* start = pmem->get_mem_ptr();
+        auto alias = [&](const mem_region& r){
+            uint8_t* base = r.pmem->get_mem_ptr();
+            return start < base + r.pmem->get_mem_size() && base < start + pmem->get_mem_size();
+        };
+        // keep the larger of two overlapping mappings
+        auto old = std::find_if(res.begin(), res.end(), alias);
+        if (old == res.end()) res.push_back({it.first.start, pmem});
+        else if (old->pmem->get_mem_size() < pmem->get_mem_size()) *old = {it.first.start, pmem};
+    }
+    return res;
+}/*}}}*/
+
+void PaddrTop::save_state(snap_writer& out){/*{{{*/
+    for (auto &it: devices) it.second->save_state(out);
+}/*}}}*/
+
+bool PaddrTop::load_state(snap_reader& in){/*{{{*/
+    bool res = true;
+    for (auto &it: devices) res &= it.second->load_state(in);
+    return res && in.ok();
+}/*}}}*/
+
+#define NO_PAGE 0xffffffffu     // ends the pages of a region
+static const uint8_t zero_page[PaddrTop::MEM_PAGE] = {};
+
+void PaddrTop::save_memory(snap_writer& out){/*{{{*/
+    auto regions = mem_regions();
+    out.put<uint32_t>(regions.size());
+    for (auto& r: regions) {
+        const uint8_t* mem = r.pmem->get_mem_ptr();
+        uint32_t nr_page = r.pmem->get_mem_size() / MEM_PAGE;
+        out.put(r.paddr);
+        out.put(nr_page);
+        for (uint32_t p = 0; p < nr_page; p++) {
+            if (memcmp(mem + p * MEM_PAGE, zero_page, MEM_PAGE) == 0) continue;
+            out.put(p);
+            out.put_bytes(mem + p * MEM_PAGE, MEM_PAGE);
+        }
+        out.put<uint32_t>(NO_PAGE);
+    }
+}/*}}}*/
+
+bool PaddrTop::load_memory(snap_reader& in){/*{{{*/
+    auto regions = mem_regions();
+    std::vector<std::vector<const uint8_t*>> pages(regions.size());
+    uint32_t nr_region = 0;
+    in.get(nr_region);
+    if (nr_region != regions.size()) return false;
+    for (size_t i = 0; i < regions.size(); i++) {
+        word_t paddr = 0;
+        uint32_t nr_page = 0, p = 0;
+        in.get(paddr);
+        in.get(nr_page);
+        if (paddr != regions[i].paddr || nr_page != regions[i].pmem->get_mem_size() / MEM_PAGE) return false;
+        pages[i].resize(nr_page);
+        while (in.get(p) && p < nr_page) pages[i][p] = in.take(MEM_PAGE);
+        if (!in.ok() || p != NO_PAGE) return false;
+    }
+    // the stream is whole, only now the memory is changed
+    for (size_t i = 0; i < regions.size(); i++) {
+        const uint8_t* mem = regions[i].pmem->get_mem_ptr();
+        for (size_t p = 0; p < pages[i].size(); p++) {
+            const uint8_t* want = pages[i][p] ? pages[i][p] : zero_page;
+            if (memcmp(mem + p * MEM_PAGE, want, MEM_PAGE))
+                regions[i].pmem->restore(p * MEM_PAGE, want, MEM_PAGE);
+        }
+    }
+    return true;
+}/*}}}*/
@@ -4,11 +4,22 @@
 #include "testbench/sim_state.hpp"
 #include "paddr/paddr_interface.hpp"
 #include "easylogging++.h"
+#include <cstdlib>
+
+// page aligned, so the page of a host address is the page of its paddr
+static constexpr size_t PMEM_ALIGN = 4096;
+static unsigned char* alloc_mem(size_t size_bytes){/*{{{*/
+    size_t align = PMEM_ALIGN;
+    void* mem = aligned_alloc(align, (size_bytes + align - 1) & ~(align - 1));
+    Assert(mem, "Pmem fail to allocate %lx bytes", size_bytes);
+    return (unsigned char*)mem;
+}/*}}}*/
 
 Pmem::Pmem(word_t size_bytes, el::Logger* input_logger): PaddrInterface(input_logger) {/*{{{*/
     Assert(IS_2_POW(size_bytes),"Pmem size is not 2 power: %x",size_bytes);
-    mem = new unsigned char[size_bytes];
+    mem = alloc_mem(size_bytes);
     mem_size = size_bytes;
+    write_hook = nullptr;
 }/*}}}*/
 
 Pmem::Pmem(const AddrIntv &_range, el::Logger* input_logger): 
@@ -18,60 +29,21 @@ Pmem::Pmem(const AddrIntv &_range, unsigned char *init_binary, el::Logger* input
     PaddrInterface(input_logger) {
     word_t size_bytes = _range.mask+1;
     Assert(IS_2_POW(size_bytes),"Pmem size is not 2 power: %x",size_bytes);
+    Assert(((uintptr_t)init_binary & (PMEM_ALIGN - 1)) == 0, "Pmem memory %p is not page aligned", init_binary);
     mem = init_binary;
     mem_size = size_bytes;
+    write_hook = nullptr;
 }/*}}}*/
 
 Pmem::Pmem(const Pmem &src):PaddrInterface(src) {/*{{{*/
     mem_size = src.mem_size;
-    mem = new unsigned char[mem_size];
+    mem = alloc_mem(mem_size);
     memcpy(mem,src.mem,mem_size);
+    write_hook = src.write_hook;
 }/*}}}*/
 
-Pmem::~Pmem() { delete [] mem; }
+Pmem::~Pmem() { free(mem); }
 
-bool Pmem::do_read (word_t addr, wen_t info, word_t* data){/*{{{*/
-    bool res = true;
-    switch (info.size) {
-        case 1: 
-            *(uint8_t*) data = *(uint8_t*)(mem+addr);
-            break;
-        case 2: 
-            *(uint16_t*) data = *(uint16_t*)(mem+addr);
-            break;
-        case 4: 
-            *(uint32_t*) data = *(uint32_t*)(mem+addr);
-            break;
-        default:
-            res = false;
-            Assert(0,"Pmem read not support size:%x",info.size);
-    }
-    return res;
-}/*}}}*/
-bool Pmem::do_write(word_t addr, wen_t info, const word_t data){/*{{{*/
-    bool res = true;
-    switch (info.size) {
-        case 1: 
-            *(uint8_t*)(mem+addr) = (uint8_t)data ;
-            break;
-        case 2: 
-            *(uint16_t*)(mem+addr) = (uint16_t)data ;
-            break;
-        case 4: 
-            if (likely(info.wstrb==0xf)) *(uint32_t*)(mem+addr) = data;
-            else {
-                if (BITS(info.wstrb,0,0)) *(uint8_t *)(mem+addr+0) = BITS(data,7,0); 
-                if (BITS(info.wstrb,1,1)) *(uint8_t *)(mem+addr+1) = BITS(data,15,8);
-                if (BITS(info.wstrb,2,2)) *(uint8_t *)(mem+addr+2) = BITS(data,23,16);
-                if (BITS(info.wstrb,3,3)) *(uint8_t *)(mem+addr+3) = BITS(data,31,24);
-            }
-            break;
-        default:
-            res = false;
-            Assert(0,"Pmem read not support size:%x",info.size);
-    }
-    return res;
-}/*}}}*/
 void Pmem::load_binary(uint64_t offset, const char *init_file) {/*{{{*/
     std::ifstream file (init_file, std::ios::in | std::ios::binary | std::ios::ate);
     Assert(file, "file %s open error", init_file);
@@ -88,3 +60,10 @@ void Pmem::save_binary(const char *filename) {/*{{{*/
     file.write((char*)mem, mem_size);
 }/*}}}*/
 uint8_t* Pmem::get_mem_ptr() { return mem; }
+void Pmem::restore(size_t offset, const uint8_t* data, size_t len) {/*{{{*/
+    Assert(offset + len <= mem_size, "Pmem restore out of bound: %lx", offset + len);
+    memcpy(mem + offset, data, len);
+    if (write_hook) {
+        for (size_t off = 0; off < len; off += 4) write_hook(mem + offset + off);
+    }
+}/*}}}*/
@@ -158,3 +158,27 @@ void Puart8250::update_IIR() { /*{{{*/
   }
   IIR |= no_int;
 } /*}}}*/
+
+void Puart8250::save_state(snap_writer &out) { /*{{{*/
+  std::unique_lock<std::mutex> lock(rx_lock);
+  out.put_queue(rx);
+  out.put(DLL);
+  out.put(DLM);
+  out.put(IER);
+  out.put(LCR);
+  out.put(IIR);
+  out.put(MCR);
+  save_output(out);
+} /*}}}*/
+
+bool Puart8250::load_state(snap_reader &in) { /*{{{*/
+  std::unique_lock<std::mutex> lock(rx_lock);
+  in.get_queue(rx);
+  in.get(DLL);
+  in.get(DLM);
+  in.get(IER);
+  in.get(LCR);
+  in.get(IIR);
+  in.get(MCR);
+  return load_output(in);
+} /*}}}*/
@@ -65,8 +65,10 @@ void trace_and_difftest(Decode *_this) {
 #endif
 }
 
-void mips32_CPU_state::exec_once() {
+// return the number of retired instructions, at most max_run
+int mips32_CPU_state::exec_once(uint64_t max_run) {
     // TIMED_FUNC(mips32);
-    isa_exec_once(isa_query_intr());
+    int retired = isa_exec_once(isa_query_intr(), max_run);
     trace_and_difftest(&inst_state);
+    return retired;
 }
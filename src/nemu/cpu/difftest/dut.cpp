@@ -40,7 +40,7 @@ void init_difftest(PaddrTop* paddr_top){/*{{{*/
 
 static bool check_tlb_same(){
     bool same = true;
-    for (size_t i = 0; i < 16; i++) {
+    for (size_t i = 0; i < CONFIG_TLB_NR; i++) {
         bool error = false;
         const tlb_entry& nemu_entry = nemu->tlb[i];
         const mips_tlb&  cemu_entry = cemu->mmu.tlb[i];
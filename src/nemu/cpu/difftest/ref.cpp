@@ -89,6 +89,26 @@ bool CPU_state::ref_checkregs(diff_state *mycpu){/*{{{*/
     return ans;
 }/*}}}*/
 
+// only the bytes wen writes of the register written by the last instruction,
+// wen = 0 or wnum = 0 for none
+bool CPU_state::ref_check_commit(const debug_info_t *dut){/*{{{*/
+    uint8_t wnum = dut->wen ? dut->wnum : 0;
+    word_t mask = wen_mask(dut->wen);
+    bool ans = dut->pc==inst_state.pc;
+    ans &= inst_state.wnum==0 || inst_state.wnum==wnum;
+    ans &= wnum==0 || (arch_state.gpr[wnum] & mask)==(dut->wdata & mask);
+    return ans;
+}/*}}}*/
+
+void CPU_state::ref_log_commit_error(const debug_info_t *dut){/*{{{*/
+    extern void print_reg_diff(word_t ref, word_t my_ans, const char* name);
+    uint8_t wnum = dut->wen ? dut->wnum : 0;
+    print_reg_diff(inst_state.pc, dut->pc, "commit-pc");
+    print_reg_diff(inst_state.wnum, wnum, "commit-wnum");
+    word_t mask = wen_mask(dut->wen);
+    if (wnum) print_reg_diff(arch_state.gpr[wnum] & mask, dut->wdata & mask, "commit-wdata");
+}/*}}}*/
+
 void mips32_CPU_state::ref_log_error(diff_state *mycpu){/*{{{*/
     extern void print_reg_diff(word_t ref, word_t my_ans, const char* name);
     for (uint8_t i = 0; i < 32; i++) {
@@ -16,6 +16,7 @@
 SRCS-$(CONFIG_NSC_NEMU) += src/nemu/nemu-main.cpp
 
 LIBS += $(if $(CONFIG_NEED_NEMU),-lreadline -ldl)
+LIBS += $(if $(CONFIG_CHECKPOINT),-lz)
 DIRS-BLACKLIST-$(CONFIG_NSC_DIFF) += src/nemu/monitor 
 DIRS-y += src/nemu/cpu 
 DIRS-y += src/nemu/utils
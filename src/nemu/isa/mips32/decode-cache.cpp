@@ -0,0 +1,42 @@
+#include "decode-cache.hpp"
+#include "jit.hpp"
+#include <nemu/isa.hpp>
+#include <cstring>
+
+decode_cache::decode_cache(PaddrTop* ptop_input):
+    paddr_top(ptop_input),
+    last_ppn(-1),
+    last_page(nullptr),
+    new_page_hook(nullptr) {}
+
+decode_cache::decode_page* decode_cache::find_page(paddr_t ppn){/*{{{*/
+    auto it = ppn_map.find(ppn);
+    if (it != ppn_map.end()) return it->second;
+    decode_page* page = nullptr;
+    uint8_t* host = paddr_top->get_host_ptr(ppn << PAGE_SHIFT);
+    if (host) {
+        // invalidate() finds the entry of a store by its host address
+        Assert(((uintptr_t)host & PAGE_MASK) == 0, "host page of paddr " FMT_WORD " is not aligned", ppn << PAGE_SHIFT);
+        auto &slot = host_map[(uintptr_t)host >> PAGE_SHIFT];
+        if (!slot) {
+            if (new_page_hook) new_page_hook();
+            slot = std::make_unique<decode_page>();
+            memset(slot->entry, 0, sizeof(slot->entry));
+        }
+        page = slot.get();
+    }
+    ppn_map[ppn] = page;
+    return page;
+}/*}}}*/
+
+void decode_cache::invalidate(const uint8_t* host_addr){/*{{{*/
+    auto it = host_map.find((uintptr_t)host_addr >> PAGE_SHIFT);
+    if (it == host_map.end()) return;
+    int idx = ((uintptr_t)host_addr & PAGE_MASK) >> 2;
+    decode_entry* entry = &it->second->entry[idx];
+    entry->handler = nullptr;
+#ifdef CONFIG_JIT
+    // drop the runs covering this word
+    for (int i = 0; i < JIT_MAX_RUN && i <= idx; i++) entry[-i].jit = JIT_UNKNOWN;
+#endif
+}/*}}}*/
@@ -0,0 +1,62 @@
+#ifndef __DECODE_CACHE_HH__
+#define __DECODE_CACHE_HH__
+
+#include "common.hpp"
+#include "nemu/memory/vaddr.hpp"
+#include "paddr/paddr_interface.hpp"
+#include <memory>
+#include <unordered_map>
+
+// one predecoded instruction, handler is the label of its INSTPAT body
+struct decode_entry {
+    const void* handler;
+    word_t inst;
+    word_t imm;
+    uint8_t rd;
+    uint8_t rs;
+    uint8_t rt;
+    uint8_t flag;
+    uint32_t jit; // CONFIG_JIT run starting here
+};
+
+/*
+ * Predecoded instructions of each physical page. Pages are shared by host
+ * address, so aliased Pmem mappings (inst_mem and s0_mem of basic_soc) see
+ * the same entries, and a store to any alias drops the stale entry. Pmem
+ * memory is page aligned, so a host page holds exactly one physical page.
+ */
+class decode_cache {
+    private:
+        struct decode_page {
+            decode_entry entry[PAGE_SIZE >> 2];
+        };
+        PaddrTop* paddr_top;
+        // physical page number -> page, nullptr if not backed by Pmem
+        std::unordered_map<paddr_t, decode_page*> ppn_map;
+        // host page -> page
+        std::unordered_map<uintptr_t, std::unique_ptr<decode_page>> host_map;
+        paddr_t last_ppn;
+        decode_page* last_page;
+        decode_page* find_page(paddr_t ppn);
+        void (*new_page_hook)();
+    public:
+        decode_cache(PaddrTop* ptop_input);
+        // called before a host page gets its first decoded instruction
+        inline void set_new_page_hook(void (*hook)()) { new_page_hook = hook; }
+        // whether the physical page of host_addr holds decoded code, its host
+        // page is that physical page as Pmem memory is page aligned
+        inline bool has_page(const uint8_t* host_addr) {
+            return host_map.count((uintptr_t)host_addr >> PAGE_SHIFT);
+        }
+        inline decode_entry* lookup(paddr_t paddr) {
+            paddr_t ppn = paddr >> PAGE_SHIFT;
+            if (unlikely(ppn != last_ppn)) {
+                last_page = find_page(ppn);
+                last_ppn = ppn;
+            }
+            return last_page ? &last_page->entry[(paddr & PAGE_MASK) >> 2] : nullptr;
+        }
+        void invalidate(const uint8_t* host_addr);
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef __DECODE_TABLE_HH__
+#define __DECODE_TABLE_HH__
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Build time replacement of the linear INSTPAT scan. The same pattern strings
+ * are parsed by constexpr functions, then every opcode selects the one of
+ * funct/rt/rs that separates most of its patterns as second level index.
+ * A bucket keeps the matching candidates in table order, so the first one
+ * whose full key/mask fits gives the same result as the linear scan.
+ */
+
+struct inst_pattern {/*{{{*/
+    uint32_t key;
+    uint32_t mask;
+    constexpr inst_pattern(): key(0), mask(0) {}
+    constexpr inst_pattern(const char* str): key(0), mask(0) {
+        int len = 0;
+        for (; *str; str++) {
+            if (*str == ' ') continue;
+            if (*str != '0' && *str != '1' && *str != '?') throw "invalid character in pattern string";
+            key  = (key  << 1) | (*str == '1');
+            mask = (mask << 1) | (*str != '?');
+            len++;
+        }
+        if (len != 32) throw "pattern string is not 32 bits";
+    }
+    constexpr bool match(uint32_t inst) const { return (inst & mask) == key; }
+};/*}}}*/
+
+namespace decode_table_gen {/*{{{*/
+    constexpr int OPCODE_SHIFT = 26;
+    constexpr int NR_OPCODE = 64;
+    constexpr uint8_t NO_CAND = 0xff;
+    // second level: funct, rt, rs
+    constexpr int field_shift[3] = {0, 16, 21};
+    constexpr int field_bits [3] = {6, 5, 5};
+
+    constexpr uint32_t field_mask(int f) { return ((1u << field_bits[f]) - 1) << field_shift[f]; }
+    constexpr uint32_t opcode_mask() { return 0x3fu << OPCODE_SHIFT; }
+    // may pattern p match an instruction with opcode op and field f (if f>=0) equal to v
+    constexpr bool may_match(const inst_pattern& p, uint32_t op, int f, uint32_t v) {
+        uint32_t mask = opcode_mask() | (f < 0 ? 0 : field_mask(f));
+        uint32_t inst = (op << OPCODE_SHIFT) | (f < 0 ? 0 : v << field_shift[f]);
+        return (inst & p.mask & mask) == (p.key & mask);
+    }
+    template <size_t N>
+    constexpr int choose_field(const inst_pattern (&pat)[N], uint32_t op) {
+        int best = -1, best_score = 1;
+        for (int f = 0; f < 3; f++) {
+            int score = 0;
+            for (size_t i = 0; i < N; i++)
+                if (may_match(pat[i], op, -1, 0) && (pat[i].mask & field_mask(f)) == field_mask(f)) score++;
+            if (score > best_score) { best = f; best_score = score; }
+        }
+        return best;
+    }
+    template <size_t N>
+    constexpr int nr_bucket(const inst_pattern (&pat)[N]) {
+        int res = 0;
+        for (uint32_t op = 0; op < NR_OPCODE; op++) {
+            int f = choose_field(pat, op);
+            res += f < 0 ? 1 : 1 << field_bits[f];
+        }
+        return res;
+    }
+    template <size_t N>
+    constexpr int max_cand(const inst_pattern (&pat)[N]) {
+        int res = 0;
+        for (uint32_t op = 0; op < NR_OPCODE; op++) {
+            int f = choose_field(pat, op);
+            for (uint32_t v = 0; v < (f < 0 ? 1u : 1u << field_bits[f]); v++) {
+                int nr = 0;
+                for (size_t i = 0; i < N; i++) nr += may_match(pat[i], op, f, v);
+                if (nr > res) res = nr;
+            }
+        }
+        return res + 1; // NO_CAND terminated
+    }
+}/*}}}*/
+
+template <size_t N, int NR_BUCKET, int MAX_CAND>
+class decode_table {/*{{{*/
+    static_assert(N < decode_table_gen::NO_CAND, "too many instruction patterns");
+    private:
+        struct level1 {
+            uint8_t shift;
+            uint32_t mask;
+            uint16_t base;
+        };
+        inst_pattern pat[N];
+        level1 op[decode_table_gen::NR_OPCODE];
+        uint8_t cand[NR_BUCKET][MAX_CAND];
+    public:
+        constexpr decode_table(const inst_pattern (&pattern)[N]): pat(), op(), cand() {
+            using namespace decode_table_gen;
+            for (size_t i = 0; i < N; i++) pat[i] = pattern[i];
+            int base = 0;
+            for (uint32_t o = 0; o < NR_OPCODE; o++) {
+                int f = choose_field(pattern, o);
+                op[o].shift = f < 0 ? 0 : field_shift[f];
+                op[o].mask  = f < 0 ? 0 : (1u << field_bits[f]) - 1;
+                op[o].base  = base;
+                for (uint32_t v = 0; v <= op[o].mask; v++, base++) {
+                    int nr = 0;
+                    for (size_t i = 0; i < N; i++)
+                        if (may_match(pattern[i], o, f, v)) cand[base][nr++] = i;
+                    for (; nr < MAX_CAND; nr++) cand[base][nr] = NO_CAND;
+                }
+            }
+        }
+        // index of the first pattern matching inst, -1 if none
+        inline int match(uint32_t inst) const {
+            const level1& l = op[inst >> decode_table_gen::OPCODE_SHIFT];
+            const uint8_t* c = cand[l.base + ((inst >> l.shift) & l.mask)];
+            for (; *c != decode_table_gen::NO_CAND; c++) {
+                if (pat[*c].match(inst)) return *c;
+            }
+            return -1;
+        }
+};/*}}}*/
+
+#define DECODE_TABLE(pattern) \
+    decode_table<sizeof(pattern) / sizeof(pattern[0]), decode_table_gen::nr_bucket(pattern), decode_table_gen::max_cand(pattern)>(pattern)
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * MIPS32 instruction table, no include guard: included with different
+ * INSTPAT(pattern, name, type, body) definitions to build the decode table,
+ * the operand types and the execute bodies of decode_exec().
+ * Order matters, the first matched pattern wins.
+ * Nothing is thrown: a body ends with TRY() on a step that raised an
+ * exception, so it never writes registers or memory after the trap.
+ */
+
+//R type 
+//      opcode  rs      rt      rd  
+//      6       5       5       5
+//      [31:26] [25:21] [20:16] [15:11] [10:6] [5:0]
+INSTPAT("000000 ?????   ?????   ?????   00000  100000", add    , R, inst_add(rd, src1, src2))
+INSTPAT("000000 ?????   ?????   ?????   00000  100001", addu   , R, Rw(rd, src1 + src2))
+INSTPAT("000000 ?????   ?????   ?????   00000  100010", sub    , R, inst_add(rd, src1, (~src2)+1))
+INSTPAT("000000 ?????   ?????   ?????   00000  100011", subu   , R, Rw(rd, src1 - src2))
+
+INSTPAT("000000 ?????   ?????   ?????   00000  100100", and    , R, Rw(rd, src1 & src2))
+INSTPAT("000000 ?????   ?????   ?????   00000  100101", or     , R, Rw(rd, src1 | src2))
+INSTPAT("000000 ?????   ?????   ?????   00000  100110", xor    , R, Rw(rd, src1 ^ src2))
+INSTPAT("000000 ?????   ?????   ?????   00000  100111", nor    , R, Rw(rd, ~(src1 | src2)))
+
+INSTPAT("000000 ?????   ?????   ?????   00000  101010", slt    , R, Rw(rd, (signed)src1 < (signed)src2))
+INSTPAT("000000 ?????   ?????   ?????   00000  101011", sltu   , R, Rw(rd, src1 < src2))
+INSTPAT("000000 00000   ?????   ?????   ?????  000000", sll    , R, Rw(rd, src2 << BITS(inst_state.inst, 10, 6)))
+INSTPAT("000000 00000   ?????   ?????   ?????  000010", srl    , R, Rw(rd, (unsigned)src2 >> BITS(inst_state.inst, 10, 6)))
+INSTPAT("000000 00000   ?????   ?????   ?????  000011", sra    , R, Rw(rd, (signed)src2 >> BITS(inst_state.inst, 10, 6)))
+INSTPAT("000000 ?????   ?????   ?????   00000  000100", sllv   , R, Rw(rd, src2 << BITS(src1, 4, 0)))
+INSTPAT("000000 ?????   ?????   ?????   00000  000110", srlv   , R, Rw(rd, (unsigned)src2 >> BITS(src1, 4, 0)))
+INSTPAT("000000 ?????   ?????   ?????   00000  000111", srav   , R, Rw(rd, (signed)src2 >> BITS(src1, 4, 0)))
+
+INSTPAT("000000 ?????   ?????   00000   00000  011000", mult   , R, hilo_valid=true;__INST_MULT__(1))
+INSTPAT("000000 ?????   ?????   00000   00000  011001", multu  , R, hilo_valid=true;__INST_MULT__(0))
+INSTPAT("000000 ?????   ?????   00000   00000  011010", div    , R, hilo_valid=true;arch_state.lo = (signed)src1/(signed)src2; arch_state.hi = (signed)src1%(signed)src2)
+INSTPAT("000000 ?????   ?????   00000   00000  011011", divu   , R, hilo_valid=true;arch_state.lo = src1/src2; arch_state.hi = src1%src2;)
+INSTPAT("000000 00000   00000   ?????   00000  010000", mfhi   , R, Rw(rd, arch_state.hi))
+INSTPAT("000000 00000   00000   ?????   00000  010010", mflo   , R, Rw(rd, arch_state.lo))
+
+//I type 
+//      opcode  rs      rt      imm
+//      6       5       5       16
+//      [31:26] [25:21] [20:16] [15:0]
+INSTPAT("001000 ?????   ?????   ????? ????? ??????", addi   , I, inst_add(rd, src1, imm))
+INSTPAT("001001 ?????   ?????   ????? ????? ??????", addui  , I, Rw(rd, src1 + imm))
+INSTPAT("001010 ?????   ?????   ????? ????? ??????", slti   , I, Rw(rd, (signed)src1 < (signed)imm))
+INSTPAT("001011 ?????   ?????   ????? ????? ??????", sltiu  , I, Rw(rd, (unsigned)src1 < (unsigned)imm))
+
+INSTPAT("100000 ?????   ?????   ????? ????? ??????", lb     , I, TRY(Mr(src1 + imm, 1, mdata)); Rw(rd, SEXT(mdata, 8)))
+INSTPAT("100010 ?????   ?????   ????? ????? ??????", lwl    , I, TRY(inst_lwl(src1 + imm, R(rd), mdata)); Rw(rd, mdata))
+INSTPAT("100100 ?????   ?????   ????? ????? ??????", lbu    , I, TRY(Mr(src1 + imm, 1, mdata)); Rw(rd, BITS(mdata, 7, 0))) 
+INSTPAT("100110 ?????   ?????   ????? ????? ??????", lwr    , I, TRY(inst_lwr(src1 + imm, R(rd), mdata)); Rw(rd, mdata))
+INSTPAT("100001 ?????   ?????   ????? ????? ??????", lh     , I, TRY(align_check(src1+imm, 0x1, EC_AdEL) && Mr(src1+imm, 2, mdata)); Rw(rd, SEXT(mdata, 16)))
+INSTPAT("100011 ?????   ?????   ????? ????? ??????", lw     , I, TRY(align_check(src1+imm, 0x3, EC_AdEL) && Mr(src1+imm, 4, mdata)); Rw(rd, mdata)) 
+INSTPAT("100101 ?????   ?????   ????? ????? ??????", lhu    , I, TRY(align_check(src1+imm, 0x1, EC_AdEL) && Mr(src1+imm, 2, mdata)); Rw(rd, BITS(mdata, 15, 0)))
+
+INSTPAT("101000 ?????   ?????   ????? ????? ??????", sb     , I, Mw(src1 + imm, 0x11, R(rd)))
+INSTPAT("101001 ?????   ?????   ????? ????? ??????", sh     , I, TRY(align_check(src1+imm, 0x1, EC_AdES)); Mw(src1+imm, 0x32, R(rd)))
+INSTPAT("101010 ?????   ?????   ????? ????? ??????", swl    , I, inst_swl(src1 + imm, R(rd)))
+INSTPAT("101011 ?????   ?????   ????? ????? ??????", sw     , I, TRY(align_check(src1+imm, 0x3, EC_AdES)); Mw(src1+imm, 0xf4, R(rd)))
+INSTPAT("101110 ?????   ?????   ????? ????? ??????", swr    , I, inst_swr(src1 + imm, R(rd)))
+
+//U type 
+//      opcode  rs      rt      imm
+//      6       5       5       16
+//      [31:26] [25:21] [20:16] [15:0]
+INSTPAT("001100 ?????   ?????   ????? ????? ??????", andi   , U, Rw(rd, imm & src1))
+INSTPAT("001101 ?????   ?????   ????? ????? ??????", ori    , U, Rw(rd, imm | src1))
+INSTPAT("001110 ?????   ?????   ????? ????? ??????", xori   , U, Rw(rd, imm ^ src1))
+INSTPAT("001111 00000   ?????   ????? ????? ??????", lui    , U, Rw(rd, imm << 16)) 
+INSTPAT("000000 ?????   00000   00000 00000 010001", mthi   , U, hilo_valid=true;arch_state.hi = src1)
+INSTPAT("000000 ?????   00000   00000 00000 010011", mtlo   , U, hilo_valid=true;arch_state.lo = src1)
+INSTPAT("010000 00000   ?????   ????? 00000 000???", mfc0   , U, inst_mfc0(imm, rd)) 
+INSTPAT("010000 00100   ?????   ????? 00000 000???", mtc0   , U, inst_mtc0(imm, rd))
+
+INSTPAT("000000 ?????   ?????   ????? ????? 001101", break  , N, isa_raise_intr(EC_Bp,inst_state.pc))
+INSTPAT("000000 ?????   ?????   ????? ????? 001100", syscall, N, isa_raise_intr(EC_Sys,inst_state.pc))
+INSTPAT("010000 10000   00000   00000 00000 011000", eret   , N, inst_eret())
+
+//B type 
+//      opcode  rs      rt      imm
+//      6       5       5       16
+//      [31:26] [25:21] [20:16] [15:0]
+INSTPAT("000100 ?????   ?????   ????? ????? ??????", beq    , B, inst_branch(src1==R(BITS(inst_state.inst,20,16)), imm, inst_state.snpc))
+INSTPAT("000101 ?????   ?????   ????? ????? ??????", bne    , B, inst_branch(src1!=R(BITS(inst_state.inst,20,16)), imm, inst_state.snpc))
+INSTPAT("000001 ?????   00000   ????? ????? ??????", bltz   , B, inst_branch((signed)src1 <  0, imm, inst_state.snpc))
+INSTPAT("000001 ?????   10000   ????? ????? ??????", bltzal , B, inst_branch((signed)src1 <  0, imm, inst_state.snpc);Rw(31, inst_state.snpc + 4);)
+INSTPAT("000001 ?????   00001   ????? ????? ??????", bgez   , B, inst_branch((signed)src1 >= 0, imm, inst_state.snpc))
+INSTPAT("000001 ?????   10001   ????? ????? ??????", bgezal , B, inst_branch((signed)src1 >= 0, imm, inst_state.snpc);Rw(31, inst_state.snpc + 4);)
+INSTPAT("000111 ?????   00000   ????? ????? ??????", bgtz   , B, inst_branch((signed)src1 >  0, imm, inst_state.snpc))
+INSTPAT("000110 ?????   00000   ????? ????? ??????", blez   , B, inst_branch((signed)src1 <= 0, imm, inst_state.snpc))
+
+//J type 
+//      opcode  rs      0       rd 
+//      6       5       5       16
+//      [31:26] [25:21] [20:16] [15:11]
+INSTPAT("000010 ?????   ?????   ????? ????? ??????", j      , J, inst_jump((BITS(inst_state.pc, 31, 28)<<28) | imm))
+INSTPAT("000011 ?????   ?????   ????? ????? ??????", jal    , J, inst_jump((BITS(inst_state.pc, 31, 28)<<28) | imm); Rw(31, inst_state.snpc+4))
+INSTPAT("000000 ?????   00000   00000 00000 001000", jr     , J, inst_jump(src1))
+INSTPAT("000000 ?????   00000   ????? 00000 001001", jalr   , J, inst_jump(src1); Rw(rd, inst_state.snpc + 4))
+
+#ifdef CONFIG_MIPS_RLS1
+// for uboot
+INSTPAT("011100 ?????   ?????   ????? 00000 000010", mul    , R, hilo_valid=false; Rw(rd, ((signed)src1 * (signed)src2)))
+INSTPAT("000000 ?????   ?????   ????? 00000 001011", movn   , R, Rw(rd, (src2!=0) ? src1 : R(rd)))
+INSTPAT("000000 ?????   ?????   ????? 00000 001010", movz   , R, Rw(rd, (src2==0) ? src1 : R(rd)))
+INSTPAT("101111 ?????   ?????   ????? ????? ??????", cache  , N, )
+INSTPAT("000000 00000   00000   00000 ????? 001111", sync   , N, )
+INSTPAT("000000 ?????   00000   00000 1???? 001000", jrhb   , J, inst_jump(src1))
+// for linux
+INSTPAT("011100 ?????   ?????   00000 00000 000000", madd   , R, inst_madd(src1, src2))
+INSTPAT("011100 ?????   ?????   00000 00000 000001", maddu  , R, inst_maddu(src1, src2))
+INSTPAT("011100 ?????   ?????   00000 00000 000100", msub   , R, inst_msub(src1, src2))
+INSTPAT("010000 10000   00000   00000 00000 001000", tlbp   , N, tlbp())
+INSTPAT("010000 10000   00000   00000 00000 000001", tlbr   , N, tlbr())
+INSTPAT("010000 10000   00000   00000 00000 000010", tlbwi  , N, tlbwi()) //TODO: machine exception
+INSTPAT("010000 10000   00000   00000 00000 000110", tlbwr  , N, tlbwr()) //TODO: machine exception
+INSTPAT("110000 ?????   ?????   ????? ????? ??????", ll     , I, if (align_check(src1+imm, 0x3, EC_AdEL) && Mr(src1+imm, 4, mdata)) Rw(rd, mdata); arch_state.llbit=1)
+INSTPAT("111000 ?????   ?????   ????? ????? ??????", sc     , I, inst_sc(rd, src1+imm))
+INSTPAT("000000 ?????   ?????   ????? ????? 110110", tne    , R, if (src1!=src2) isa_raise_intr(EC_Tr))
+INSTPAT("000000 ?????   ?????   ????? ????? 110100", teq    , R, if (src1==src2) isa_raise_intr(EC_Tr))
+INSTPAT("011100 ?????   ?????   ????? 00000 100000", clz    , R, inst_clz(src1, rd))
+INSTPAT("110011 ?????   ?????   ????? ????? ??????", pref   , N, )
+INSTPAT("010000 1????   ?????   ????? ????? 100000", wait   , N, )
+#endif /* CONFIG_MIPS_RLS1 */
+INSTPAT("011??? ?????   ?????   ????? ?????  ??????", ri_011 , N, isa_raise_intr(EC_RI, inst_state.pc))
+INSTPAT("0101?? ?????   ?????   ????? ?????  ??????", ri_bl  , N, isa_raise_intr(EC_RI, inst_state.pc))
+#ifdef CONFIG_TEST_FUNC
+/* only func test need RI else is CpU */
+INSTPAT("010001 01110   11111   00000 00011  100000", ri_ft  , N, isa_raise_intr(EC_RI, inst_state.pc))
+#endif
+INSTPAT("010??? ?????   ?????   ????? ?????  ??????", ri_cop , N, isa_raise_intr(EC_CpU, inst_state.pc))
+INSTPAT("100111 ?????   ?????   ????? ?????  ??????", ri_47  , N, isa_raise_intr(EC_RI, inst_state.pc))
+INSTPAT("10110? ?????   ?????   ????? ?????  ??????", ri_101 , N, isa_raise_intr(EC_RI, inst_state.pc))
+INSTPAT("11???? ?????   ?????   ????? ?????  ??????", ri_11x , N, isa_raise_intr(EC_RI, inst_state.pc))
+
+// INSTPAT("011100 ????? ????? ????? ????? 111111", sdbbp  , N, NEMUTRAP(inst_state.pc, R(2))); // R(2) is $v0;
+INSTPAT("?????? ????? ????? ????? ????? ??????", inv    , N, INV(inst_state.inst))
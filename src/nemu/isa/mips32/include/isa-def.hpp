@@ -18,6 +18,11 @@
 
 #include "common.hpp"
 #include "cp0.hpp"
+#include "decode-cache.hpp"
+#include "tb-cache.hpp"
+#include "jit.hpp"
+#include "soft-tlb.hpp"
+#include "tlb_index.hpp"
 #include "disassemble.hpp"
 #include "easylogging++.h"
 #include "macro.hpp"
@@ -26,6 +31,7 @@
 #include "nemu/memory/vaddr.hpp"
 #include "nemu/mytrace.hpp"
 #include "paddr/paddr_interface.hpp"
+#include "snapshot.hpp"
 #include <fmt/core.h>
 #include <memory>
 #include <string>
@@ -45,9 +51,26 @@ public:
   Decode inst_state;
   bool analysis;
   bool e_protect;
+  IFDEF(CONFIG_DECODE_CACHE, decode_cache dcache;)
+#ifdef CONFIG_BB_CACHE
+  tb_cache tbc;
+  translation_block *cur_tb;
+  int tb_idx;
+  translation_block *tb_translate(vaddr_t pc, uint8_t asid, bool mapped);
+  decode_entry *tb_fetch(vaddr_t pc, paddr_t &paddr);
+#endif
+#ifdef CONFIG_SOFT_TLB
+  soft_tlb stlb;
+  void stlb_fill(vaddr_t addr, paddr_t paddr, bool write);
+#endif
+#ifdef CONFIG_JIT
+  jit_cache jitc;
+  uint32_t jit_translate(decode_entry *op, paddr_t paddr);
+  int jit_exec(decode_entry *op, paddr_t paddr, uint64_t max_run);
+#endif
 
   mips32_CPU_state(PaddrTop *ptop_input);
-  void exec_once();
+  int exec_once(uint64_t max_run = 1);
   void reset(word_t reset_pc = 0xbfc00000);
 
   // nemu difftest ref api{{{
@@ -58,13 +81,22 @@ public:
   void ref_get_state(diff_state *dut);
   bool ref_checkregs(diff_state *mycpu);
   void ref_log_error(diff_state *mycpu);
+  bool ref_check_commit(const debug_info_t *dut);
+  void ref_log_commit_error(const debug_info_t *dut);
   void ref_get_debug_info(debug_info_t *ref);
+  // move count and random as if n more (n < 0: fewer) ticks had passed
+  void ref_shift_ticks(int64_t n);
   // }}}
 
+  // checkpoint of the cpu: registers, CP0, TLB, delay slot and interrupt
+  // state; memory is saved with the devices. Loading drops the caches.
+  void save_state(snap_writer &out);
+  bool load_state(snap_reader &in);
+
   // nemu difftest utils api{{{
   bool isa_difftest_checkregs(diff_state *ref_r);
   void isa_difftest_log_error(diff_state *ref_r);
-  int isa_exec_once(bool has_int);
+  int isa_exec_once(bool has_int, uint64_t max_run = 1);
   diff_state *isa_diff_state() { return &arch_state; }
   /*}}}*/
 
@@ -72,7 +104,15 @@ public:
   void isa_reg_display();
   word_t isa_reg_str2val(const char *s, bool *success);
   // }}}
-  word_t isa_vaddr_read(vaddr_t addr, int len) { return vaddr_read(addr, len); }
+  // debugger read, never raises, 0 if not accessible
+  word_t isa_vaddr_read(vaddr_t addr, int len) {
+    bool protect = e_protect;
+    word_t data = 0;
+    e_protect = true;
+    vaddr_read(addr, len, data);
+    e_protect = protect;
+    return data;
+  }
   const std::string &isa_disasm_inst() {
     return llvm_disassemble(inst_state.pc, inst_state.inst);
   }
@@ -89,24 +129,33 @@ private:
 #define Mw vaddr_write
 #define __NOT_DELAY__                                                          \
   __ASSERT_NEMU__(!is_delay_slot, "this instr can not be delay slot")
-  int decode_exec();
+  int decode_exec(decode_entry *cached);
+  static bool isa_is_branch(word_t inst);
+  IFDEF(CONFIG_JIT, static jit_op_t isa_jit_op(word_t inst);)
   void decode_operand(int *rd, word_t *src1, word_t *src2, word_t *imm,
                       int type);
   void check_link(int rs);
-  word_t inst_lwl(word_t addr, word_t src2) { /*{{{*/
-    word_t memword = Mr(addr & ~(0x3), 4);
+  // helpers that may raise return false after isa_raise_intr()
+  bool inst_lwl(word_t addr, word_t src2, word_t &res) { /*{{{*/
+    word_t memword;
+    if (!Mr(addr & ~(0x3), 4, memword))
+      return false;
     uint8_t byte = addr & 0x3;
     uint8_t low_len = 24 - 8 * byte;
-    return (BITS(memword, 7 + 8 * byte, 0) << low_len) |
-           BITS(src2, low_len - 1, 0);
-  }                                           /*}}}*/
-  word_t inst_lwr(word_t addr, word_t src2) { /*{{{*/
-    word_t memword = Mr(addr & ~(0x3), 4);
+    res = (BITS(memword, 7 + 8 * byte, 0) << low_len) |
+          BITS(src2, low_len - 1, 0);
+    return true;
+  }                                                       /*}}}*/
+  bool inst_lwr(word_t addr, word_t src2, word_t &res) { /*{{{*/
+    word_t memword;
+    if (!Mr(addr & ~(0x3), 4, memword))
+      return false;
     uint8_t byte = addr & 0x3;
     uint8_t low_len = 32 - 8 * byte;
-    return (BITS(src2, 31, low_len) << low_len) | BITS(memword, 31, 8 * byte);
+    res = (BITS(src2, 31, low_len) << low_len) | BITS(memword, 31, 8 * byte);
+    return true;
   }                                         /*}}}*/
-  void inst_swl(word_t addr, word_t src2) { /*{{{*/
+  bool inst_swl(word_t addr, word_t src2) { /*{{{*/
     const int swl_len[8] = {
         0x14,
         0x34,
@@ -115,9 +164,9 @@ private:
     };
     uint8_t byte = addr & 0x3;
     word_t data = BITS(src2, 31, 24 - 8 * byte);
-    Mw(addr & ~(0x3), swl_len[byte], data);
+    return Mw(addr & ~(0x3), swl_len[byte], data);
   }                                         /*}}}*/
-  void inst_swr(word_t addr, word_t src2) { /*{{{*/
+  bool inst_swr(word_t addr, word_t src2) { /*{{{*/
     const int swr_len[8] = {
         0xf4,
         0xe4,
@@ -126,7 +175,7 @@ private:
     };
     uint8_t byte = addr & 0x3;
     word_t data = BITS(src2, 31 - 8 * byte, 0) << (8 * byte);
-    Mw(addr & ~(0x3), swr_len[byte], data);
+    return Mw(addr & ~(0x3), swr_len[byte], data);
   }                                    /*}}}*/
   inline void inst_jump(word_t dest) { /*{{{*/
     next_is_delay_slot = true;
@@ -158,12 +207,15 @@ private:
   }                                           /*}}}*/
   inline void inst_mtc0(word_t imm, int rd) { /*{{{*/
     uint8_t pos = imm | imm >> 8;
+    IFDEF(CONFIG_BB_CACHE, cur_tb = nullptr); // may change ASID or ERL
+    IFDEF(CONFIG_SOFT_TLB, uint8_t asid = cp0.entryhi.asid; bool erl = cp0.status.erl);
     if (cp0.write(pos, R(rd)) == false) {
       nemu_state.state = NEMU_ABORT;
       log_pt->error(fmt::format("write not unimplemented CP0 {}({},{})",
                                 cp0.find_name(pos), (pos & 0xff) >> 3,
                                 pos & 0x7));
     }
+    IFDEF(CONFIG_SOFT_TLB, if (asid != cp0.entryhi.asid || erl != cp0.status.erl) stlb.flush());
   }                                                            /*}}}*/
   inline void inst_add(uint8_t rd, word_t src1, word_t src2) { /*{{{*/
     word_t ans = src1 + src2;
@@ -171,15 +223,19 @@ private:
     bool sign_src2 = src2 >> 31;
     bool sign_ans = ans >> 31;
     if ((!sign_src1 && !sign_src2 && sign_ans) ||
-        (sign_src1 && sign_src2 && !sign_ans))
+        (sign_src1 && sign_src2 && !sign_ans)) {
       isa_raise_intr(EC_Ov);
+      return;
+    }
     Rw(rd, ans);
   } /*}}}*/
-  inline word_t align_check(word_t addr, word_t mask,
-                            ExcCode_t eccode) { /*{{{*/
-    if (unlikely(mask & addr))
+  inline bool align_check(word_t addr, word_t mask,
+                          ExcCode_t eccode) { /*{{{*/
+    if (unlikely(mask & addr)) {
       isa_raise_intr(eccode, addr);
-    return addr;
+      return false;
+    }
+    return true;
   }                                          /*}}}*/
   void inst_madd(word_t src1, word_t src2) { /*{{{*/
     int64_t ans = ((uint64_t)arch_state.hi) << 32 | arch_state.lo;
@@ -208,7 +264,8 @@ private:
   void tlbwi();
   void tlbwr();
   void inst_sc(int rd, word_t addr) { /*{{{*/
-    Mw(align_check(addr, 0x3, EC_AdES), 0xf4, R(rd));
+    if (!align_check(addr, 0x3, EC_AdES) || !Mw(addr, 0xf4, R(rd)))
+      return;
     Rw(rd, 1);
 
     // bool& llbit = arch_state.llbit;
@@ -231,11 +288,14 @@ private:
 
   // Exception method{{{
   uint32_t int_delay;
+  // enter the exception, the caller must stop the instruction;
+  // does nothing under e_protect
   void isa_raise_intr(word_t NO, vaddr_t badva = 0, bool refill = false);
   bool isa_query_intr();
   // }}}
 public:
   tlb_entry tlb[CONFIG_TLB_NR];
+  tlb_index<CONFIG_TLB_NR> tlb_idx;
   enum mode_t {
     USER,
     SPVI,
@@ -252,9 +312,29 @@ public:
   mmu_t mmu_check(vaddr_t vaddr);
   tlb_info mmu_translate(vaddr_t vaddr, paddr_t &paddr, bool &refill);
   tlb_entry *tlb_match(vaddr_t vaddr);
-  word_t vaddr_ifetch(vaddr_t addr, int len);
-  word_t vaddr_read(vaddr_t addr, int len);
-  void vaddr_write(vaddr_t addr, int len, word_t data);
+  // false if an exception was raised
+  bool ifetch_translate(vaddr_t addr, paddr_t &paddr);
+  bool vaddr_ifetch(vaddr_t addr, int len, word_t &data);
+  bool vaddr_read_slow(vaddr_t addr, int len, word_t &data);
+  bool vaddr_write_slow(vaddr_t addr, int len, word_t data);
+  inline bool vaddr_read(vaddr_t addr, int len, word_t &data) {
+#ifdef CONFIG_SOFT_TLB
+    if (uint8_t *host = stlb.read_ptr(addr)) {
+      data = soft_tlb::host_read(host, len);
+      return true;
+    }
+#endif
+    return vaddr_read_slow(addr, len, data);
+  }
+  inline bool vaddr_write(vaddr_t addr, int len, word_t data) {
+#ifdef CONFIG_SOFT_TLB
+    if (uint8_t *host = stlb.write_ptr(addr)) {
+      soft_tlb::host_write(host, len, data);
+      return true;
+    }
+#endif
+    return vaddr_write_slow(addr, len, data);
+  }
 
 private:
   ftracer mips_ftracer;
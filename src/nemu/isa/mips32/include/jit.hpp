@@ -0,0 +1,74 @@
+#ifndef __JIT_HH__
+#define __JIT_HH__
+
+#include "common.hpp"
+#include "decode-cache.hpp"
+#include <vector>
+
+// instructions with a native template: register operands only, never raise
+enum jit_op_t : uint8_t {
+    JIT_NONE,
+    JIT_ADDU, JIT_SUBU, JIT_AND, JIT_OR, JIT_XOR, JIT_NOR, JIT_SLT, JIT_SLTU,
+    JIT_SLL, JIT_SRL, JIT_SRA, JIT_SLLV, JIT_SRLV, JIT_SRAV,
+    JIT_ADDIU, JIT_SLTI, JIT_SLTIU, JIT_ANDI, JIT_ORI, JIT_XORI, JIT_LUI,
+};
+
+// jit op of an INSTPAT name, evaluated while building the decode table
+constexpr jit_op_t jit_op(const char* name) {/*{{{*/
+    struct op_name { const char* name; jit_op_t op; };
+    constexpr op_name ops[] = {
+        {"addu", JIT_ADDU}, {"subu", JIT_SUBU}, {"and", JIT_AND}, {"or", JIT_OR},
+        {"xor", JIT_XOR}, {"nor", JIT_NOR}, {"slt", JIT_SLT}, {"sltu", JIT_SLTU},
+        {"sll", JIT_SLL}, {"srl", JIT_SRL}, {"sra", JIT_SRA},
+        {"sllv", JIT_SLLV}, {"srlv", JIT_SRLV}, {"srav", JIT_SRAV},
+        {"addui", JIT_ADDIU}, {"slti", JIT_SLTI}, {"sltiu", JIT_SLTIU},
+        {"andi", JIT_ANDI}, {"ori", JIT_ORI}, {"xori", JIT_XORI}, {"lui", JIT_LUI},
+    };
+    for (const op_name& o: ops) {
+        const char *a = o.name, *b = name;
+        for (; *a && *a == *b; a++, b++);
+        if (*a == *b) return o.op;
+    }
+    return JIT_NONE;
+}/*}}}*/
+
+// decode_entry::jit: run index, or one of
+#define JIT_UNKNOWN 0
+#define JIT_NO_RUN  1
+// longest run, a code store drops the runs of this many words before it
+#define JIT_MAX_RUN 32
+
+typedef void (*jit_code_t)(word_t* gpr);
+
+// host code of a straight-line run of jit ops, a load, store, branch or any
+// other instruction ends it, so this is a JIT of ALU runs only
+struct jit_run {
+    jit_code_t code;
+    uint16_t len;
+    uint8_t last_rd;
+    word_t last_inst;
+};
+
+/*
+ * x86-64 code buffer. Runs are owned by the decode entry of their first
+ * instruction; when the buffer is full every run is dropped and the owners
+ * compile again on their next execution.
+ */
+class jit_cache {
+    private:
+        uint8_t* buf;
+        size_t used;
+        std::vector<jit_run> runs;
+        std::vector<decode_entry*> owners;
+        static constexpr size_t BUF_SIZE = 16 << 20;
+        static constexpr size_t MAX_INST_BYTES = 16;
+        void flush();
+    public:
+        jit_cache();
+        ~jit_cache();
+        // compile len words of host to a run owned by op, return its index
+        uint32_t compile(decode_entry* op, const uint32_t* host, const jit_op_t* jop, int len);
+        inline const jit_run& get(uint32_t idx) const { return runs[idx]; }
+};
+
+#endif
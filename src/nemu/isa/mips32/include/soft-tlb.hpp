@@ -0,0 +1,68 @@
+#ifndef __SOFT_TLB_HH__
+#define __SOFT_TLB_HH__
+
+#include "common.hpp"
+#include "nemu/memory/vaddr.hpp"
+#include <cstring>
+
+/*
+ * Direct mapped vaddr page -> host page of RAM, for loads and stores that
+ * hit in it. Valid for the current ASID and ERL only, flushed when they or
+ * the TLB change. Pages holding decoded instructions never get a write entry,
+ * so every store to code still goes through Pmem and its write hook.
+ */
+class soft_tlb {
+    private:
+        struct entry {
+            word_t vpn;         // INVALID_VPN if empty
+            uintptr_t addend;   // host address - vaddr
+        };
+        static constexpr int NR_ENTRY = 256;
+        static constexpr word_t INVALID_VPN = -1;
+        entry rd[NR_ENTRY];
+        entry wr[NR_ENTRY];
+        static inline entry& slot(entry* tab, vaddr_t addr) {
+            return tab[(addr >> PAGE_SHIFT) & (NR_ENTRY - 1)];
+        }
+        static inline uint8_t* probe(entry* tab, vaddr_t addr) {
+            entry& e = slot(tab, addr);
+            return e.vpn == addr >> PAGE_SHIFT ? (uint8_t*)(e.addend + addr) : nullptr;
+        }
+        static inline void fill(entry* tab, vaddr_t addr, uint8_t* host) {
+            entry& e = slot(tab, addr);
+            e.vpn = addr >> PAGE_SHIFT;
+            e.addend = (uintptr_t)host - addr;
+        }
+    public:
+        soft_tlb() { flush(); }
+        // host address of addr, nullptr on a miss
+        inline uint8_t* read_ptr(vaddr_t addr) { return probe(rd, addr); }
+        inline uint8_t* write_ptr(vaddr_t addr) { return probe(wr, addr); }
+        // host is the host address of addr
+        inline void fill_read(vaddr_t addr, uint8_t* host) { fill(rd, addr, host); }
+        inline void fill_write(vaddr_t addr, uint8_t* host) { fill(wr, addr, host); }
+        void flush() { flush_write(); for (entry& e: rd) e.vpn = INVALID_VPN; }
+        void flush_write() { for (entry& e: wr) e.vpn = INVALID_VPN; }
+
+        // same result as Pmem::do_read/do_write, len as paddr_read/paddr_write
+        static inline word_t host_read(const uint8_t* host, int len) {/*{{{*/
+            switch (len & 0xf) {
+                case 1: return *host;
+                case 2: { uint16_t v; memcpy(&v, host, 2); return v; }
+                default: { uint32_t v; memcpy(&v, host, 4); return v; }
+            }
+        }/*}}}*/
+        static inline void host_write(uint8_t* host, int len, word_t data) {/*{{{*/
+            switch (len & 0xf) {
+                case 1: *host = data; break;
+                case 2: { uint16_t v = data; memcpy(host, &v, 2); break; }
+                default:
+                    if (likely((len >> 4) == 0xf)) memcpy(host, &data, 4);
+                    else for (int i = 0; i < 4; i++) {
+                        if (BITS(len, 4 + i, 4 + i)) host[i] = data >> (8 * i);
+                    }
+            }
+        }/*}}}*/
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __TB_CACHE_HH__
+#define __TB_CACHE_HH__
+
+#include "common.hpp"
+#include "decode-cache.hpp"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// guest basic block: up to a branch and its delay slot, never crossing a page
+struct translation_block {
+    vaddr_t pc;
+    uint8_t asid;               // 0 if not mapped
+    bool mapped;
+    uint16_t len;               // 0 after invalidation
+    paddr_t paddr;
+    decode_entry* op;           // into the decode cache page of paddr
+    translation_block* next[2]; // chained successor: fall through, jump
+};
+
+/*
+ * Blocks keyed by (vaddr, ASID, mapped). An invalidated block keeps its slot
+ * and is translated again in place, so chained pointers never dangle; only
+ * flush() frees blocks.
+ */
+class tb_cache {
+    private:
+        std::unordered_map<uint64_t, std::unique_ptr<translation_block>> blocks;
+        // vpn2 -> mapped blocks in it
+        std::unordered_map<word_t, std::vector<translation_block*>> mapped_blocks;
+        static constexpr size_t MAX_BLOCKS = 1 << 18;
+    public:
+        static inline uint64_t key(vaddr_t pc, uint8_t asid, bool mapped) {
+            return (uint64_t)pc << 9 | asid << 1 | mapped;
+        }
+        translation_block* find(uint64_t key);
+        void add_mapped(translation_block* tb);
+        void invalidate_vpn2(word_t vpn2);
+        inline bool full() { return blocks.size() >= MAX_BLOCKS; }
+        void flush();
+};
+
+#endif
@@ -43,15 +43,29 @@ void CPU_state::reset(word_t reset_pc) {/*{{{*/
     for (int i = 0; i < 32; i++) {
         arch_state.gpr[i] = 0;
     }
-    analysis = false;
+    // the testbench records instruction times while set
+    analysis = MUXDEF(CONFIG_PERF_ANALYSES, true, false);
+    IFDEF(CONFIG_BB_CACHE, cur_tb = nullptr);
+    IFDEF(CONFIG_SOFT_TLB, stlb.flush());
     cp0.reset();
 }/*}}}*/
+#ifdef CONFIG_DECODE_CACHE
+static void decode_cache_write_hook(const uint8_t* host_addr) { nemu->dcache.invalidate(host_addr); }
+#endif
+#if defined(CONFIG_DECODE_CACHE) && defined(CONFIG_SOFT_TLB)
+static void decode_cache_new_page_hook() { nemu->stlb.flush_write(); }
+#endif
 CPU_state::mips32_CPU_state(PaddrTop* ptop_input): 
     log_pt(ptop_input->log_pt), 
     paddr_top(ptop_input),
+    IFDEF(CONFIG_DECODE_CACHE, dcache(ptop_input),)
     mips_ftracer(__TEST_ELF__, ptop_input->log_pt, CONFIG_RESET_PC)
 {
     Assert(IS_2_POW(CONFIG_TLB_NR), "TLB entry number is not power of 2");
+    IFDEF(CONFIG_DECODE_CACHE, ptop_input->set_write_hook(decode_cache_write_hook));
+#if defined(CONFIG_DECODE_CACHE) && defined(CONFIG_SOFT_TLB)
+    dcache.set_new_page_hook(decode_cache_new_page_hook);
+#endif
 };
 
 void init_isa(PaddrTop* ptop_input) {
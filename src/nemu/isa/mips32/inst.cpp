@@ -19,7 +19,9 @@
 #include "easylogging++.h"
 #include "local-include/reg.hpp"
 #include <nemu/cpu/ifetch.hpp>
+#include <nemu/memory/paddr.hpp>
 #include "isa-def.hpp"
+#include "decode-table.hpp"
 #include "utils.hpp"
 #include <csignal>
 
@@ -74,6 +76,19 @@ void mips32_CPU_state::decode_operand(int *rd, word_t *src1, word_t *src2, word_
   }
 }
 
+#undef INSTPAT
+static constexpr inst_pattern inst_patterns[] = {
+#define INSTPAT(pattern, name, type, ...) inst_pattern(pattern),
+#include "inst-list.hpp"
+#undef INSTPAT
+};
+static constexpr uint8_t inst_type[] = {
+#define INSTPAT(pattern, name, type, ...) concat(TYPE_, type),
+#include "inst-list.hpp"
+#undef INSTPAT
+};
+static constexpr auto inst_table = DECODE_TABLE(inst_patterns);
+
 #define __INST_MULT__(is_signed) \
     MUXONE(is_signed, int64_t, uint64_t) a = (MUXONE(is_signed,signed,uint64_t))src1; \
     MUXONE(is_signed, int64_t, uint64_t) b = (MUXONE(is_signed,signed,uint64_t))src2; \
@@ -81,157 +96,75 @@ void mips32_CPU_state::decode_operand(int *rd, word_t *src1, word_t *src2, word_
     arch_state.hi = BITS(res,63,32); \
     arch_state.lo = BITS(res,31,0);
 
-int mips32_CPU_state::decode_exec() {
+int mips32_CPU_state::decode_exec(decode_entry *cached) {
   int rd = 0;
   inst_state.skip = false;
   word_t src1 = 0, src2 = 0, imm = 0;
-
-#define INSTPAT_INST(s) ((inst_state).inst)
-#define INSTPAT_MATCH(s, name, type, ... /* execute body */ ) { \
-    decode_operand(&rd, &src1, &src2, &imm, concat(TYPE_, type)); \
-    __VA_ARGS__ ; \
-}
-#define EXPT(...) try { __VA_ARGS__; } catch (int e) {}
-  INSTPAT_START();
-
-  //R type 
-  //      opcode  rs      rt      rd  
-  //      6       5       5       5
-  //      [31:26] [25:21] [20:16] [15:11] [10:6] [5:0]
-  INSTPAT("000000 ?????   ?????   ?????   00000  100000", add    , R, EXPT(inst_add(rd, src1, src2)));
-  INSTPAT("000000 ?????   ?????   ?????   00000  100001", addu   , R, Rw(rd, src1 + src2));
-  INSTPAT("000000 ?????   ?????   ?????   00000  100010", sub    , R, EXPT(inst_add(rd, src1, (~src2)+1)));
-  INSTPAT("000000 ?????   ?????   ?????   00000  100011", subu   , R, Rw(rd, src1 - src2));
-
-  INSTPAT("000000 ?????   ?????   ?????   00000  100100", and    , R, Rw(rd, src1 & src2));
-  INSTPAT("000000 ?????   ?????   ?????   00000  100101", or     , R, Rw(rd, src1 | src2));
-  INSTPAT("000000 ?????   ?????   ?????   00000  100110", xor    , R, Rw(rd, src1 ^ src2));
-  INSTPAT("000000 ?????   ?????   ?????   00000  100111", nor    , R, Rw(rd, ~(src1 | src2)));
-
-  INSTPAT("000000 ?????   ?????   ?????   00000  101010", slt    , R, Rw(rd, (signed)src1 < (signed)src2));
-  INSTPAT("000000 ?????   ?????   ?????   00000  101011", sltu   , R, Rw(rd, src1 < src2));
-  INSTPAT("000000 00000   ?????   ?????   ?????  000000", sll    , R, Rw(rd, src2 << BITS(inst_state.inst, 10, 6)));
-  INSTPAT("000000 00000   ?????   ?????   ?????  000010", srl    , R, Rw(rd, (unsigned)src2 >> BITS(inst_state.inst, 10, 6)));
-  INSTPAT("000000 00000   ?????   ?????   ?????  000011", sra    , R, Rw(rd, (signed)src2 >> BITS(inst_state.inst, 10, 6)));
-  INSTPAT("000000 ?????   ?????   ?????   00000  000100", sllv   , R, Rw(rd, src2 << BITS(src1, 4, 0)));
-  INSTPAT("000000 ?????   ?????   ?????   00000  000110", srlv   , R, Rw(rd, (unsigned)src2 >> BITS(src1, 4, 0)));
-  INSTPAT("000000 ?????   ?????   ?????   00000  000111", srav   , R, Rw(rd, (signed)src2 >> BITS(src1, 4, 0)));
-
-  INSTPAT("000000 ?????   ?????   00000   00000  011000", mult   , R, hilo_valid=true;__INST_MULT__(1));
-  INSTPAT("000000 ?????   ?????   00000   00000  011001", multu  , R, hilo_valid=true;__INST_MULT__(0));
-  INSTPAT("000000 ?????   ?????   00000   00000  011010", div    , R, hilo_valid=true;arch_state.lo = (signed)src1/(signed)src2; arch_state.hi = (signed)src1%(signed)src2);
-  INSTPAT("000000 ?????   ?????   00000   00000  011011", divu   , R, hilo_valid=true;arch_state.lo = src1/src2; arch_state.hi = src1%src2;);
-  INSTPAT("000000 00000   00000   ?????   00000  010000", mfhi   , R, Rw(rd, arch_state.hi));
-  INSTPAT("000000 00000   00000   ?????   00000  010010", mflo   , R, Rw(rd, arch_state.lo));
-  
-  //I type 
-  //      opcode  rs      rt      imm
-  //      6       5       5       16
-  //      [31:26] [25:21] [20:16] [15:0]
-  INSTPAT("001000 ?????   ?????   ????? ????? ??????", addi   , I, EXPT(inst_add(rd, src1, imm)));
-  INSTPAT("001001 ?????   ?????   ????? ????? ??????", addui  , I, Rw(rd, src1 + imm));
-  INSTPAT("001010 ?????   ?????   ????? ????? ??????", slti   , I, Rw(rd, (signed)src1 < (signed)imm));
-  INSTPAT("001011 ?????   ?????   ????? ????? ??????", sltiu  , I, Rw(rd, (unsigned)src1 < (unsigned)imm));
-
-  INSTPAT("100000 ?????   ?????   ????? ????? ??????", lb     , I, EXPT(Rw(rd, SEXT(Mr(src1 + imm, 1),8))));
-  INSTPAT("100010 ?????   ?????   ????? ????? ??????", lwl    , I, EXPT(Rw(rd, inst_lwl(src1 + imm, R(rd)))));
-  INSTPAT("100100 ?????   ?????   ????? ????? ??????", lbu    , I, EXPT(Rw(rd, BITS(Mr(src1 + imm, 1),7,0)))); 
-  INSTPAT("100110 ?????   ?????   ????? ????? ??????", lwr    , I, EXPT(Rw(rd, inst_lwr(src1 + imm, R(rd)))));
-  INSTPAT("100001 ?????   ?????   ????? ????? ??????", lh     , I, EXPT(Rw(rd, SEXT(Mr(align_check(src1+imm, 0x1, EC_AdEL), 2),16))));
-  INSTPAT("100011 ?????   ?????   ????? ????? ??????", lw     , I, EXPT(Rw(rd, Mr(align_check(src1+imm, 0x3, EC_AdEL), 4)))); 
-  INSTPAT("100101 ?????   ?????   ????? ????? ??????", lhu    , I, EXPT(Rw(rd, BITS(Mr(align_check(src1+imm, 0x1, EC_AdEL), 2),15,0))));
-
-  INSTPAT("101000 ?????   ?????   ????? ????? ??????", sb     , I, EXPT(Mw(src1 + imm, 0x11, R(rd))));
-  INSTPAT("101001 ?????   ?????   ????? ????? ??????", sh     , I, EXPT(Mw(align_check(src1+imm, 0x1, EC_AdES), 0x32, R(rd))));
-  INSTPAT("101010 ?????   ?????   ????? ????? ??????", swl    , I, EXPT(inst_swl(src1 + imm, R(rd))));
-  INSTPAT("101011 ?????   ?????   ????? ????? ??????", sw     , I, EXPT(Mw(align_check(src1+imm, 0x3, EC_AdES), 0xf4, R(rd))));
-  INSTPAT("101110 ?????   ?????   ????? ????? ??????", swr    , I, EXPT(inst_swr(src1 + imm, R(rd))));
-  
-  //U type 
-  //      opcode  rs      rt      imm
-  //      6       5       5       16
-  //      [31:26] [25:21] [20:16] [15:0]
-  INSTPAT("001100 ?????   ?????   ????? ????? ??????", addi   , U, Rw(rd, imm & src1));
-  INSTPAT("001101 ?????   ?????   ????? ????? ??????", ori    , U, Rw(rd, imm | src1));
-  INSTPAT("001110 ?????   ?????   ????? ????? ??????", xori   , U, Rw(rd, imm ^ src1));
-  INSTPAT("001111 00000   ?????   ????? ????? ??????", lui    , U, Rw(rd, imm << 16)); 
-  INSTPAT("000000 ?????   00000   00000 00000 010001", mthi   , U, hilo_valid=true;arch_state.hi = src1);
-  INSTPAT("000000 ?????   00000   00000 00000 010011", mtlo   , U, hilo_valid=true;arch_state.lo = src1);
-  INSTPAT("010000 00000   ?????   ????? 00000 000???", mfc0   , U, inst_mfc0(imm, rd)); 
-  INSTPAT("010000 00100   ?????   ????? 00000 000???", mtc0   , U, inst_mtc0(imm, rd));
-
-  INSTPAT("000000 ?????   ?????   ????? ????? 001101", break  , N, EXPT(isa_raise_intr(EC_Bp,inst_state.pc)));
-  INSTPAT("000000 ?????   ?????   ????? ????? 001100", syscall, N, EXPT(isa_raise_intr(EC_Sys,inst_state.pc)));
-  INSTPAT("010000 10000   00000   00000 00000 011000", eret   , N, inst_eret());/*}}}*/
-
-  //B type 
-  //      opcode  rs      rt      imm
-  //      6       5       5       16
-  //      [31:26] [25:21] [20:16] [15:0]
-  INSTPAT("000100 ?????   ?????   ????? ????? ??????", beq    , B, inst_branch(src1==R(BITS(inst_state.inst,20,16)), imm, inst_state.snpc));
-  INSTPAT("000101 ?????   ?????   ????? ????? ??????", bne    , B, inst_branch(src1!=R(BITS(inst_state.inst,20,16)), imm, inst_state.snpc));
-  INSTPAT("000001 ?????   00000   ????? ????? ??????", bltz   , B, inst_branch((signed)src1 <  0, imm, inst_state.snpc));
-  INSTPAT("000001 ?????   10000   ????? ????? ??????", bltzal , B, inst_branch((signed)src1 <  0, imm, inst_state.snpc);Rw(31, inst_state.snpc + 4););
-  INSTPAT("000001 ?????   00001   ????? ????? ??????", bgez   , B, inst_branch((signed)src1 >= 0, imm, inst_state.snpc));
-  INSTPAT("000001 ?????   10001   ????? ????? ??????", bgezal , B, inst_branch((signed)src1 >= 0, imm, inst_state.snpc);Rw(31, inst_state.snpc + 4););
-  INSTPAT("000111 ?????   00000   ????? ????? ??????", bgtz   , B, inst_branch((signed)src1 >  0, imm, inst_state.snpc));
-  INSTPAT("000110 ?????   00000   ????? ????? ??????", blez   , B, inst_branch((signed)src1 <= 0, imm, inst_state.snpc));
-  
-  //J type 
-  //      opcode  rs      0       rd 
-  //      6       5       5       16
-  //      [31:26] [25:21] [20:16] [15:11]
-  INSTPAT("000010 ?????   ?????   ????? ????? ??????", j      , J, inst_jump((BITS(inst_state.pc, 31, 28)<<28) | imm));
-  INSTPAT("000011 ?????   ?????   ????? ????? ??????", jal    , J, inst_jump((BITS(inst_state.pc, 31, 28)<<28) | imm); Rw(31, inst_state.snpc+4));
-  INSTPAT("000000 ?????   00000   00000 00000 001000", jr     , J, inst_jump(src1));
-  INSTPAT("000000 ?????   00000   ????? 00000 001001", jalr   , J, inst_jump(src1); Rw(rd, inst_state.snpc + 4));
-  
-#ifdef CONFIG_MIPS_RLS1
-  // for uboot
-  INSTPAT("011100 ?????   ?????   ????? 00000 000010", mul    , R, hilo_valid=false; Rw(rd, ((signed)src1 * (signed)src2)));
-  INSTPAT("000000 ?????   ?????   ????? 00000 001011", movn   , R, Rw(rd, (src2!=0) ? src1 : R(rd)));
-  INSTPAT("000000 ?????   ?????   ????? 00000 001010", movz   , R, Rw(rd, (src2==0) ? src1 : R(rd)));
-  INSTPAT("101111 ?????   ?????   ????? ????? ??????", cache  , N, );
-  INSTPAT("000000 00000   00000   00000 ????? 001111", sync   , N, );
-  INSTPAT("000000 ?????   00000   00000 1???? 001000", jrhb   , J, inst_jump(src1));
-  // for linux
-  INSTPAT("011100 ?????   ?????   00000 00000 000000", madd   , R, inst_madd(src1, src2));
-  INSTPAT("011100 ?????   ?????   00000 00000 000001", maddu  , R, inst_maddu(src1, src2));
-  INSTPAT("011100 ?????   ?????   00000 00000 000100", msub   , R, inst_msub(src1, src2));
-  INSTPAT("010000 10000   00000   00000 00000 001000", tlbp   , N, tlbp());
-  INSTPAT("010000 10000   00000   00000 00000 000001", tlbr   , N, tlbr());
-  INSTPAT("010000 10000   00000   00000 00000 000010", tlbwi  , N, EXPT(tlbwi())); //TODO: machine exception
-  INSTPAT("010000 10000   00000   00000 00000 000110", tlbwr  , N, EXPT(tlbwr())); //TODO: machine exception
-  INSTPAT("110000 ?????   ?????   ????? ????? ??????", ll     , I, EXPT(Rw(rd, Mr(align_check(src1+imm, 0x3, EC_AdEL), 4)));arch_state.llbit=1);
-  INSTPAT("111000 ?????   ?????   ????? ????? ??????", sc     , I, EXPT(inst_sc(rd, src1+imm)));
-  INSTPAT("000000 ?????   ?????   ????? ????? 110110", tne    , R, EXPT(if (src1!=src2) isa_raise_intr(EC_Tr)));
-  INSTPAT("000000 ?????   ?????   ????? ????? 110100", teq    , R, EXPT(if (src1==src2) isa_raise_intr(EC_Tr)));
-  INSTPAT("011100 ?????   ?????   ????? 00000 100000", clz    , R, inst_clz(src1, rd));
-  INSTPAT("110011 ?????   ?????   ????? ????? ??????", pref   , N, );
-  INSTPAT("010000 1????   ?????   ????? ????? 100000", wait   , N, );
-#endif /* CONFIG_MIPS_RLS1 */
-  INSTPAT("011??? ?????   ?????   ????? ?????  ??????", ri_011 , N, EXPT(isa_raise_intr(EC_RI, inst_state.pc)));
-  INSTPAT("0101?? ?????   ?????   ????? ?????  ??????", ri_bl  , N, EXPT(isa_raise_intr(EC_RI, inst_state.pc)));
-#ifdef CONFIG_TEST_FUNC
-  /* only func test need RI else is CpU */
-  INSTPAT("010001 01110   11111   00000 00011  100000", ri_ft  , N, EXPT(isa_raise_intr(EC_RI, inst_state.pc)));
+  word_t mdata = 0; // memory operand of loads
+  static const void * const body[] = {
+#define INSTPAT(pattern, name, type, ...) &&concat(__instpat_body_, __LINE__),
+#include "inst-list.hpp"
+#undef INSTPAT
+  };
+
+#ifdef CONFIG_DECODE_CACHE
+  if (cached && cached->handler) {
+    rd = cached->rd;
+    src1 = R(cached->rs);
+    src2 = R(cached->rt);
+    imm = cached->imm;
+    inst_state.flag = cached->flag;
+    goto *cached->handler;
+  }
 #endif
-  INSTPAT("010??? ?????   ?????   ????? ?????  ??????", ri_cop , N, EXPT(isa_raise_intr(EC_CpU, inst_state.pc)));
-  INSTPAT("100111 ?????   ?????   ????? ?????  ??????", ri_47  , N, EXPT(isa_raise_intr(EC_RI, inst_state.pc)));
-  INSTPAT("10110? ?????   ?????   ????? ?????  ??????", ri_101 , N, EXPT(isa_raise_intr(EC_RI, inst_state.pc)));
-  INSTPAT("11???? ?????   ?????   ????? ?????  ??????", ri_11x , N, EXPT(isa_raise_intr(EC_RI, inst_state.pc)));
+  {
+    int idx = inst_table.match(inst_state.inst);
+    if (unlikely(idx < 0)) {
+      INV(inst_state.inst);
+      goto __instpat_end;
+    }
+    decode_operand(&rd, &src1, &src2, &imm, inst_type[idx]);
+    IFDEF(CONFIG_DECODE_CACHE, if (cached) *cached = (decode_entry){
+        body[idx], inst_state.inst, imm, (uint8_t)rd,
+        (uint8_t)BITS(inst_state.inst, 25, 21), (uint8_t)BITS(inst_state.inst, 20, 16), inst_state.flag });
+    goto *body[idx];
+  }
+
+// a step that raised an exception ends the instruction
+#define TRY(step) do { if (unlikely(!(step))) goto __instpat_end; } while (0)
+#define INSTPAT(pattern, name, type, ... /* execute body */ ) \
+  concat(__instpat_body_, __LINE__): { __VA_ARGS__ ; } goto __instpat_end;
+#include "inst-list.hpp"
+#undef INSTPAT
 
-  // INSTPAT("011100 ????? ????? ????? ????? 111111", sdbbp  , N, NEMUTRAP(inst_state.pc, R(2))); // R(2) is $v0;
-  INSTPAT("?????? ????? ????? ????? ????? ??????", inv    , N, INV(inst_state.inst));
-  INSTPAT_END();
+__instpat_end:
 
   R(0) = 0; // reset $zero to 0
   inst_state.wdata = R(inst_state.wnum);
   return 0;
 }
 
-int mips32_CPU_state::isa_exec_once(bool has_int) {
+bool mips32_CPU_state::isa_is_branch(word_t inst) {
+  int idx = inst_table.match(inst);
+  return idx >= 0 && (inst_type[idx] == TYPE_B || inst_type[idx] == TYPE_J);
+}
+
+#ifdef CONFIG_JIT
+static constexpr jit_op_t inst_jit_op[] = {
+#define INSTPAT(pattern, name, type, ...) jit_op(#name),
+#include "inst-list.hpp"
+#undef INSTPAT
+};
+
+jit_op_t mips32_CPU_state::isa_jit_op(word_t inst) {
+  int idx = inst_table.match(inst);
+  return idx < 0 ? JIT_NONE : inst_jit_op[idx];
+}
+#endif
+
+int mips32_CPU_state::isa_exec_once(bool has_int, uint64_t max_run) {
     // TIMED_FUNC(isa_exec_once);
+    int retired = 1;
     inst_state.wnum = 0;
     inst_state.flag = 0;
 
@@ -240,21 +173,43 @@ int mips32_CPU_state::isa_exec_once(bool has_int) {
     inst_state.is_delay_slot = next_is_delay_slot;
     next_is_delay_slot = false;
     // if (this_pc==0x80100ad0) raise(SIGTRAP);
-    try {
-        if (has_int) (isa_raise_intr(EC_Int, arch_state.pc));
-        inst_state.inst = vaddr_ifetch(align_check(inst_state.snpc,0x3,EC_AdEL), 4);
-        inst_state.snpc += 4;
-        inst_state.dnpc = inst_state.is_delay_slot ? delay_slot_npc : inst_state.snpc;
-        decode_exec();
-    } catch (int e) {}
+    paddr_t inst_paddr = 0;
+    decode_entry *cached = nullptr;
+    bool fetched = false;
+    if (has_int) isa_raise_intr(EC_Int, arch_state.pc);
+    else {
+        cached = MUXDEF(CONFIG_BB_CACHE, tb_fetch(inst_state.snpc, inst_paddr), nullptr);
+        fetched = cached != nullptr;
+        if (!fetched && align_check(inst_state.snpc,0x3,EC_AdEL) && ifetch_translate(inst_state.snpc, inst_paddr)) {
+            fetched = true;
+            cached = MUXDEF(CONFIG_DECODE_CACHE, dcache.lookup(inst_paddr), nullptr);
+        }
+    }
+    if (fetched) {
+        int jit_len = 0;
+        IFDEF(CONFIG_JIT, if (max_run > 1 && cached && !inst_state.is_delay_slot)
+                jit_len = jit_exec(cached, inst_paddr, max_run));
+        if (jit_len) retired = jit_len;
+        else {
+            if (cached && cached->handler) {
+                inst_state.inst = cached->inst;
+                IFDEF(CONFIG_MTRACE, read_mtrace((wen_t){.size = 4, .wstrb = 0xf}, inst_paddr, inst_state.inst));
+            }
+            else inst_state.inst = paddr_read(inst_paddr, 4);
+            inst_state.snpc += 4;
+            inst_state.dnpc = inst_state.is_delay_slot ? delay_slot_npc : inst_state.snpc;
+            decode_exec(cached);
+        }
+    }
 
     //TODO:check pc finish conditions
     // if (this_pc==0x9fc13178)
     //     analysis = !analysis;
-    IFDEF(CONFIG_TEST_FUNC, if (this_pc==0xbfc00100) nemu_state.state = NEMU_END);
-    IFDEF(CONFIG_TEST_PERF, if (this_pc==0xbfc00100) nemu_state.state = NEMU_END);
+    // inst_state.pc is the last pc of a jit run
+    IFDEF(CONFIG_TEST_FUNC, if (this_pc<=0xbfc00100 && 0xbfc00100<=inst_state.pc) nemu_state.state = NEMU_END);
+    IFDEF(CONFIG_TEST_PERF, if (this_pc<=0xbfc00100 && 0xbfc00100<=inst_state.pc) nemu_state.state = NEMU_END);
     arch_state.pc = inst_state.dnpc;
     extern uint32_t log_pc;
     log_pc = this_pc;
-    return 0;
+    return retired;
 }
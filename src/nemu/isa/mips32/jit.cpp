@@ -0,0 +1,132 @@
+#include "jit.hpp"
+#include <nemu/isa.hpp>
+#include <algorithm>
+#include <sys/mman.h>
+
+#ifdef CONFIG_JIT
+#ifndef __x86_64__
+#error "CONFIG_JIT emits x86-64 code"
+#endif
+
+namespace {
+enum { EAX = 0, ECX = 1 };
+// 32 bit ops on eax/ecx, guest gpr array in rdi
+struct x86_emitter {/*{{{*/
+    uint8_t* p;
+    void byte(uint8_t b) { *p++ = b; }
+    void imm32(uint32_t imm) { memcpy(p, &imm, 4); p += 4; }
+    // opcode r32, [rdi + 4 * gpr]
+    void mem(uint8_t opcode, int reg, int gpr) { byte(opcode); byte(0x47 | reg << 3); byte(4 * gpr); }
+    void load(int reg, int gpr) { mem(0x8b, reg, gpr); }
+    void store(int gpr) { mem(0x89, EAX, gpr); }
+    void store_imm(int gpr, word_t imm) { byte(0xc7); byte(0x47); byte(4 * gpr); imm32(imm); }
+    // add/sub/and/or/xor/cmp eax, imm32
+    void alu_imm(uint8_t opcode, word_t imm) { byte(opcode); imm32(imm); }
+    // shl 4, shr 5, sar 7
+    void shift_imm(int ext, int sa) { byte(0xc1); byte(0xc0 | ext << 3); byte(sa); }
+    void shift_cl(int ext) { byte(0xd3); byte(0xc0 | ext << 3); }
+    void not_eax() { byte(0xf7); byte(0xd0); }
+    // setcc al; movzx eax, al
+    void setcc(uint8_t cc) { byte(0x0f); byte(0x90 | cc); byte(0xc0); byte(0x0f); byte(0xb6); byte(0xc0); }
+    void ret() { byte(0xc3); }
+};/*}}}*/
+
+enum { CC_B = 0x2, CC_L = 0xc };
+
+// rd of a jit op, templates never write $zero
+int jit_rd(jit_op_t op, word_t inst) {
+    return op >= JIT_ADDIU ? BITS(inst, 20, 16) : BITS(inst, 15, 11);
+}
+
+void emit_inst(x86_emitter& e, jit_op_t op, word_t inst) {/*{{{*/
+    int rs = BITS(inst, 25, 21), rt = BITS(inst, 20, 16);
+    int rd = jit_rd(op, inst);
+    int sa = BITS(inst, 10, 6);
+    word_t simm = SEXT(BITS(inst, 15, 0), 16), uimm = BITS(inst, 15, 0);
+    if (rd == 0) return;
+    switch (op) {
+        case JIT_ADDU:  e.load(EAX, rs); e.mem(0x03, EAX, rt); break;
+        case JIT_SUBU:  e.load(EAX, rs); e.mem(0x2b, EAX, rt); break;
+        case JIT_AND:   e.load(EAX, rs); e.mem(0x23, EAX, rt); break;
+        case JIT_OR:    e.load(EAX, rs); e.mem(0x0b, EAX, rt); break;
+        case JIT_XOR:   e.load(EAX, rs); e.mem(0x33, EAX, rt); break;
+        case JIT_NOR:   e.load(EAX, rs); e.mem(0x0b, EAX, rt); e.not_eax(); break;
+        case JIT_SLT:   e.load(EAX, rs); e.mem(0x3b, EAX, rt); e.setcc(CC_L); break;
+        case JIT_SLTU:  e.load(EAX, rs); e.mem(0x3b, EAX, rt); e.setcc(CC_B); break;
+        case JIT_SLL:   e.load(EAX, rt); e.shift_imm(4, sa); break;
+        case JIT_SRL:   e.load(EAX, rt); e.shift_imm(5, sa); break;
+        case JIT_SRA:   e.load(EAX, rt); e.shift_imm(7, sa); break;
+        // x86 masks the count to 5 bits as well
+        case JIT_SLLV:  e.load(ECX, rs); e.load(EAX, rt); e.shift_cl(4); break;
+        case JIT_SRLV:  e.load(ECX, rs); e.load(EAX, rt); e.shift_cl(5); break;
+        case JIT_SRAV:  e.load(ECX, rs); e.load(EAX, rt); e.shift_cl(7); break;
+        case JIT_ADDIU: e.load(EAX, rs); e.alu_imm(0x05, simm); break;
+        case JIT_SLTI:  e.load(EAX, rs); e.alu_imm(0x3d, simm); e.setcc(CC_L); break;
+        case JIT_SLTIU: e.load(EAX, rs); e.alu_imm(0x3d, simm); e.setcc(CC_B); break;
+        case JIT_ANDI:  e.load(EAX, rs); e.alu_imm(0x25, uimm); break;
+        case JIT_ORI:   e.load(EAX, rs); e.alu_imm(0x0d, uimm); break;
+        case JIT_XORI:  e.load(EAX, rs); e.alu_imm(0x35, uimm); break;
+        case JIT_LUI:   e.store_imm(rd, uimm << 16); return;
+        default: Assert(0, "no template for jit op %d", op);
+    }
+    e.store(rd);
+}/*}}}*/
+}
+
+jit_cache::jit_cache(): used(0), runs(2) {/*{{{*/
+    buf = (uint8_t*)mmap(nullptr, BUF_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    Assert(buf != MAP_FAILED, "can not map jit code buffer");
+}/*}}}*/
+
+jit_cache::~jit_cache(){
+    munmap(buf, BUF_SIZE);
+}
+
+void jit_cache::flush(){/*{{{*/
+    for (auto op: owners) op->jit = JIT_UNKNOWN;
+    owners.clear();
+    runs.resize(2);
+    used = 0;
+}/*}}}*/
+
+uint32_t jit_cache::compile(decode_entry* op, const uint32_t* host, const jit_op_t* jop, int len){/*{{{*/
+    if (used + len * MAX_INST_BYTES + 1 > BUF_SIZE) flush();
+    x86_emitter e = {buf + used};
+    for (int i = 0; i < len; i++) emit_inst(e, jop[i], host[i]);
+    e.ret();
+    jit_run run = {(jit_code_t)(buf + used), (uint16_t)len,
+        (uint8_t)jit_rd(jop[len - 1], host[len - 1]), host[len - 1]};
+    used = e.p - buf;
+    runs.push_back(run);
+    owners.push_back(op);
+    return runs.size() - 1;
+}/*}}}*/
+
+uint32_t CPU_state::jit_translate(decode_entry* op, paddr_t paddr){/*{{{*/
+    const uint32_t* host = (const uint32_t*)paddr_top->get_host_ptr(paddr);
+    int max_len = std::min<int>(JIT_MAX_RUN, (PAGE_SIZE - (paddr & PAGE_MASK)) >> 2);
+    jit_op_t jop[JIT_MAX_RUN];
+    int len = 0;
+    for (; len < max_len && (jop[len] = isa_jit_op(host[len])) != JIT_NONE; len++);
+    if (len < 2) return JIT_NO_RUN;
+    return jitc.compile(op, host, jop, len);
+}/*}}}*/
+
+int CPU_state::jit_exec(decode_entry* op, paddr_t paddr, uint64_t max_run){/*{{{*/
+    if (op->jit == JIT_UNKNOWN) op->jit = jit_translate(op, paddr);
+    if (op->jit == JIT_NO_RUN) return 0;
+    const jit_run& run = jitc.get(op->jit);
+    if (run.len > max_run) return 0;
+    run.code(arch_state.gpr);
+    // leave inst_state as the last instruction of the run
+    inst_state.skip = false;
+    inst_state.pc += 4 * (run.len - 1);
+    inst_state.inst = run.last_inst;
+    inst_state.wnum = run.last_rd;
+    inst_state.wdata = R(run.last_rd);
+    inst_state.dnpc = inst_state.snpc = inst_state.pc + 4;
+    tb_idx += run.len - 1;
+    return run.len;
+}/*}}}*/
+#endif
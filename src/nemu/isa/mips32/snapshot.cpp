@@ -0,0 +1,77 @@
+#include <nemu/isa.hpp>
+#include "common.hpp"
+#include "utils.hpp"
+
+// bumped whenever a field is added, a snapshot of another layout is refused
+#define CPU_STATE_VERSION 1
+
+void CPU_state::save_state(snap_writer &out){/*{{{*/
+    out.put<uint32_t>(CPU_STATE_VERSION);
+    out.put<uint32_t>(CONFIG_TLB_NR);
+    out.put(arch_state);
+    out.put(cp0);
+    out.put(hilo_valid);
+    out.put(delay_slot_npc);
+    out.put(next_is_delay_slot);
+    out.put(raise_ex);
+    out.put(int_delay);
+    out.put(inst_state);
+    out.put(tlb);
+    out.put(nemu_state.state);
+}/*}}}*/
+
+bool CPU_state::load_state(snap_reader &in){/*{{{*/
+    uint32_t version = 0, tlb_nr = 0;
+    in.get(version);
+    in.get(tlb_nr);
+    if (version != CPU_STATE_VERSION || tlb_nr != CONFIG_TLB_NR) {
+        log_pt->error("cpu state of version %v with %v TLB entries, expect %v with %v",
+                version, tlb_nr, CPU_STATE_VERSION, CONFIG_TLB_NR);
+        return false;
+    }
+    in.get(arch_state);
+    in.get(cp0);
+    in.get(hilo_valid);
+    in.get(delay_slot_npc);
+    in.get(next_is_delay_slot);
+    in.get(raise_ex);
+    in.get(int_delay);
+    in.get(inst_state);
+    in.get(tlb);
+    in.get(nemu_state.state);
+    if (!in.ok()) {
+        log_pt->error("cpu state is truncated");
+        return false;
+    }
+    tlb_idx.reset();
+    for (int i = 0; i < CONFIG_TLB_NR; i++) tlb_idx.set(i, tlb[i].vpn2, tlb[i].asid, tlb[i].g);
+    // blocks and soft TLB entries hold translations of the old state, decoded
+    // instructions are dropped by the write hook of the restored memory
+    IFDEF(CONFIG_SOFT_TLB, stlb.flush());
+    IFDEF(CONFIG_BB_CACHE, tbc.flush(); cur_tb = nullptr);
+    return true;
+}/*}}}*/
+
+void CPU_state::ref_shift_ticks(int64_t n){/*{{{*/
+    // count goes up every other tick, random down from TLB_NR-1 to wire
+    uint32_t m = n < 0 ? -n : n;
+    uint32_t old = cp0.count.all;
+    int range = CONFIG_TLB_NR - cp0.wire.wire;
+    int pos = CONFIG_TLB_NR - 1 - cp0.random.random;
+    if (n >= 0) {
+        uint32_t inc = (m + cp0.clock_tick) / 2;
+        cp0.clock_tick ^= m & 1;
+        cp0.count.all = old + inc;
+        if (inc && (uint32_t)(cp0.compare.all - old - 1) < inc) cp0.cause.ip_h |= 1 << 5;
+        if (range > 0) pos = (pos + m) % range;
+    }
+    else {
+        cp0.clock_tick ^= m & 1;
+        uint32_t dec = (m + cp0.clock_tick) / 2;
+        cp0.count.all = old - dec;
+        // the timer interrupt was not pending yet before compare was reached
+        if (dec && (uint32_t)(old - cp0.compare.all) < dec) cp0.cause.ip_h &= ~(1 << 5);
+        if (range > 0) pos = ((pos - (int64_t)m) % range + range) % range;
+    }
+    if (range > 0) cp0.random.random = CONFIG_TLB_NR - 1 - pos;
+}/*}}}*/
@@ -39,7 +39,7 @@
 #endif
 #define EXPT_VECTOR 0xbfc00380
 void mips32_CPU_state::isa_raise_intr(word_t NO, vaddr_t badva, bool refill) {/*{{{*/
-    if (e_protect) { throw 0;}
+    if (e_protect) return;
     word_t trap_base = (cp0.status.bev ? 0xbfc00200u : (cp0.ebase.eptbase<<12|0x80000000));
     word_t trap_offs = 0x180;
     if (!cp0.status.exl){
@@ -67,7 +67,6 @@ void mips32_CPU_state::isa_raise_intr(word_t NO, vaddr_t badva, bool refill) {/*
             break;
         default:break;
     }
-    throw 0;
 }/*}}}*/
 
 bool mips32_CPU_state::isa_query_intr() {/*{{{*/
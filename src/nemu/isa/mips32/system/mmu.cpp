@@ -36,25 +36,11 @@ CPU_state::mmu_t CPU_state::mmu_check(vaddr_t vaddr){
 }
 // Exception not distinguish tlb not match and tlb invalid, can be abstract by refill
 tlb_entry* CPU_state::tlb_match(vaddr_t vaddr){
-    for (size_t i = 0; i < CONFIG_TLB_NR; i++) {
-        tlb_entry* tmp = &tlb[i];
-        bool vaddr_hit = tmp->vpn2==BITS(vaddr, 31, 13);
-        bool id_hit = tmp->g || (tmp->asid==cp0.entryhi.asid);
-        if (vaddr_hit && id_hit) return tmp;
-    }
-    return nullptr;
+    int idx = tlb_idx.match(BITS(vaddr, 31, 13), cp0.entryhi.asid);
+    return idx < 0 ? nullptr : &tlb[idx];
 }
 CPU_state::tlb_info CPU_state::mmu_translate(vaddr_t vaddr, paddr_t& paddr, bool& refill) { 
-    tlb_entry* entry = nullptr;
-    for (size_t i = 0; i < CONFIG_TLB_NR; i++) {
-        tlb_entry* tmp = &tlb[i];
-        bool vaddr_hit = tmp->vpn2==BITS(vaddr, 31, 13);
-        bool id_hit = tmp->g || (tmp->asid==cp0.entryhi.asid);
-        if (vaddr_hit && id_hit) {
-            entry = tmp;
-            break;
-        }
-    }
+    tlb_entry* entry = tlb_match(vaddr);
     refill = entry==nullptr;
     tlb_info info = {.hit = false};
     if (entry) {
@@ -66,18 +52,9 @@ CPU_state::tlb_info CPU_state::mmu_translate(vaddr_t vaddr, paddr_t& paddr, bool
     return info;
 }
 void CPU_state::tlbp(){
-    bool not_find = true;
-    for (size_t i = 0; i < CONFIG_TLB_NR; i++) {
-        tlb_entry* tmp = &tlb[i];
-        bool vaddr_hit = tmp->vpn2==cp0.entryhi.vpn2;
-        bool id_hit = tmp->g || (tmp->asid==cp0.entryhi.asid);
-        if (vaddr_hit && id_hit) {
-            cp0.index.index = i;
-            not_find = false;
-            break;
-        }
-    }
-    cp0.index.p = not_find;
+    int idx = tlb_idx.match(cp0.entryhi.vpn2, cp0.entryhi.asid);
+    if (idx >= 0) cp0.index.index = idx;
+    cp0.index.p = idx < 0;
 }
 //TODO: modify tlb_entry struct for 
 //difftest  (fast to build and small size) 
@@ -87,8 +64,11 @@ void CPU_state::tlbr(){
     int tlb_seq = cp0.index.index;
     __ASSERT_NEMU__(tlb_seq < CONFIG_TLB_NR, "tlbwi illegal parameter");
     tlb_entry& entry = tlb[tlb_seq];
+    IFDEF(CONFIG_BB_CACHE, cur_tb = nullptr); // may change ASID
+    IFDEF(CONFIG_SOFT_TLB, uint8_t asid = cp0.entryhi.asid);
     cp0.entryhi.vpn2 = entry.vpn2;
     cp0.entryhi.asid = entry.asid;
+    IFDEF(CONFIG_SOFT_TLB, if (asid != cp0.entryhi.asid) stlb.flush());
     cp0.entrylo0.c = entry.c0;
     cp0.entrylo0.d = entry.d0;
     cp0.entrylo0.v = entry.v0;
@@ -104,6 +84,8 @@ void CPU_state::tlbwi(){
     int tlb_seq = cp0.index.index;
     __ASSERT_NEMU__(tlb_seq < CONFIG_TLB_NR, "tlbwi illegal parameter");
     tlb_entry& entry = tlb[tlb_seq];
+    IFDEF(CONFIG_BB_CACHE, tbc.invalidate_vpn2(entry.vpn2); tbc.invalidate_vpn2(cp0.entryhi.vpn2));
+    IFDEF(CONFIG_SOFT_TLB, stlb.flush());
     entry.vpn2 = cp0.entryhi.vpn2 ;
     entry.asid = cp0.entryhi.asid ;
     entry.c0 = cp0.entrylo0.c ;
@@ -115,11 +97,14 @@ void CPU_state::tlbwi(){
     entry.v1 = cp0.entrylo1.v ;
     entry.pfn1 = cp0.entrylo1.pfn ;
     entry.g = cp0.entrylo0.g && cp0.entrylo1.g;
+    tlb_idx.set(tlb_seq, entry.vpn2, entry.asid, entry.g);
 }
 void CPU_state::tlbwr(){
     int tlb_seq = cp0.random.random;
     __ASSERT_NEMU__(tlb_seq < CONFIG_TLB_NR, "tlbwi illegal parameter");
     tlb_entry& entry = tlb[tlb_seq];
+    IFDEF(CONFIG_BB_CACHE, tbc.invalidate_vpn2(entry.vpn2); tbc.invalidate_vpn2(cp0.entryhi.vpn2));
+    IFDEF(CONFIG_SOFT_TLB, stlb.flush());
     entry.vpn2 = cp0.entryhi.vpn2 ;
     entry.asid = cp0.entryhi.asid ;
     entry.c0 = cp0.entrylo0.c ;
@@ -131,4 +116,5 @@ void CPU_state::tlbwr(){
     entry.v1 = cp0.entrylo1.v ;
     entry.pfn1 = cp0.entrylo1.pfn ;
     entry.g = cp0.entrylo0.g && cp0.entrylo1.g;
+    tlb_idx.set(tlb_seq, entry.vpn2, entry.asid, entry.g);
 }   
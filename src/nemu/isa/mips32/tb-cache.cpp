@@ -0,0 +1,94 @@
+#include "tb-cache.hpp"
+#include <nemu/isa.hpp>
+
+#ifdef CONFIG_BB_CACHE
+
+translation_block* tb_cache::find(uint64_t key){/*{{{*/
+    auto &slot = blocks[key];
+    if (!slot) {
+        slot = std::make_unique<translation_block>();
+        memset(slot.get(), 0, sizeof(translation_block));
+    }
+    return slot.get();
+}/*}}}*/
+
+void tb_cache::add_mapped(translation_block* tb){/*{{{*/
+    mapped_blocks[BITS(tb->pc, 31, 13)].push_back(tb);
+}/*}}}*/
+
+void tb_cache::invalidate_vpn2(word_t vpn2){/*{{{*/
+    auto it = mapped_blocks.find(vpn2);
+    if (it == mapped_blocks.end()) return;
+    for (auto tb: it->second) tb->len = 0;
+    mapped_blocks.erase(it);
+}/*}}}*/
+
+void tb_cache::flush(){/*{{{*/
+    blocks.clear();
+    mapped_blocks.clear();
+}/*}}}*/
+
+translation_block* CPU_state::tb_translate(vaddr_t pc, uint8_t asid, bool mapped){/*{{{*/
+    if (pc & 0x3) return nullptr;
+    if (tbc.full()) {
+        tbc.flush();
+        cur_tb = nullptr;
+    }
+    translation_block* tb = tbc.find(tb_cache::key(pc, asid, mapped));
+    if (tb->len) return tb;
+
+    paddr_t paddr;
+    bool protect = e_protect;
+    e_protect = true;
+    bool fetched = ifetch_translate(pc, paddr);
+    e_protect = protect;
+    if (!fetched) return nullptr;
+    decode_entry* op = dcache.lookup(paddr);
+    if (op == nullptr) return nullptr;
+
+    const uint32_t* host = (const uint32_t*)paddr_top->get_host_ptr(paddr);
+    int max_len = (PAGE_SIZE - (paddr & PAGE_MASK)) >> 2;
+    int len = 0;
+    bool delay_slot = false;
+    while (len < max_len) {
+        word_t inst = host[len++];
+        if (delay_slot) break;
+        delay_slot = isa_is_branch(inst);
+    }
+    tb->pc = pc;
+    tb->asid = asid;
+    tb->mapped = mapped;
+    tb->paddr = paddr;
+    tb->op = op;
+    tb->next[0] = tb->next[1] = nullptr;
+    tb->len = len;
+    if (mapped) tbc.add_mapped(tb);
+    return tb;
+}/*}}}*/
+
+decode_entry* CPU_state::tb_fetch(vaddr_t pc, paddr_t &paddr){/*{{{*/
+    translation_block* tb = cur_tb;
+    if (!(tb && tb->len && tb_idx < tb->len && pc == tb->pc + 4 * tb_idx)) {
+        mmu_t mmu = mmu_check(pc);
+        if (mmu == MMU_FAIL) {
+            cur_tb = nullptr;
+            return nullptr;
+        }
+        bool mapped = mmu == MMU_TRANSLATE;
+        uint8_t asid = mapped ? cp0.entryhi.asid : 0;
+        bool chain = tb && tb->len;
+        int slot = (chain && pc == tb->pc + 4 * tb->len) ? 0 : 1;
+        translation_block* next = chain ? tb->next[slot] : nullptr;
+        if (!(next && next->len && next->pc == pc && next->asid == asid && next->mapped == mapped)) {
+            next = tb_translate(pc, asid, mapped);
+            // tb_translate may flush all blocks
+            if (chain && next && cur_tb) tb->next[slot] = next;
+        }
+        cur_tb = tb = next;
+        tb_idx = 0;
+        if (tb == nullptr) return nullptr;
+    }
+    paddr = tb->paddr + 4 * tb_idx;
+    return &tb->op[tb_idx++];
+}/*}}}*/
+#endif
@@ -18,46 +18,58 @@
 #include <nemu/isa.hpp>
 #include <paddr/nemu_paddr.hpp>
 
-word_t CPU_state::vaddr_ifetch(vaddr_t addr, int len) {
-    word_t paddr = addr & 0x1fffffff;
+bool CPU_state::ifetch_translate(vaddr_t addr, paddr_t &paddr) {
     bool refill = false;
     switch (mmu_check(addr)) {
         case MMU_DIRECT:
             paddr = addr & 0x1fffffff;
             break;
         case MMU_TRANSLATE:
-            if (mmu_translate(addr,paddr,refill).hit==false) 
+            if (mmu_translate(addr,paddr,refill).hit==false) {
                 isa_raise_intr(EC_TLBL, addr, refill);
+                return false;
+            }
             break;
         case MMU_FAIL:
             isa_raise_intr(EC_AdEL, addr);
-            break;
+            return false;
     }
+    return true;
+}
+
+bool CPU_state::vaddr_ifetch(vaddr_t addr, int len, word_t &data) {
     //TODO: Bus Error Exception
-    return paddr_read(paddr, len);
+    paddr_t paddr;
+    if (!ifetch_translate(addr, paddr)) return false;
+    data = paddr_read(paddr, len);
+    return true;
 }
 
-word_t CPU_state::vaddr_read(vaddr_t addr, int len) {
-    word_t paddr = addr & 0x1fffffff;
+bool CPU_state::vaddr_read_slow(vaddr_t addr, int len, word_t &data) {
+    paddr_t paddr = addr & 0x1fffffff;
     bool refill = false;
     switch (mmu_check(addr)) {
         case MMU_DIRECT:
             paddr = addr & 0x1fffffff;
             break;
         case MMU_TRANSLATE:
-            if (mmu_translate(addr,paddr,refill).hit==false) 
+            if (mmu_translate(addr,paddr,refill).hit==false) {
                 isa_raise_intr(EC_TLBL, addr, refill);
+                return false;
+            }
             break;
         case MMU_FAIL:
             isa_raise_intr(EC_AdEL, addr);
-            break;
+            return false;
     }
     //TODO: Bus Error Exception
-    return paddr_read(paddr, len);
+    data = paddr_read(paddr, len);
+    IFDEF(CONFIG_SOFT_TLB, stlb_fill(addr, paddr, false));
+    return true;
 }
 
-void CPU_state::vaddr_write(vaddr_t addr, int len, word_t data) {
-    word_t paddr = addr & 0x1fffffff;
+bool CPU_state::vaddr_write_slow(vaddr_t addr, int len, word_t data) {
+    paddr_t paddr = addr & 0x1fffffff;
     bool refill = false;
     switch (mmu_check(addr)) {
         case MMU_DIRECT:
@@ -65,16 +77,32 @@ void CPU_state::vaddr_write(vaddr_t addr, int len, word_t data) {
             break;
         case MMU_TRANSLATE:{
             const tlb_info& info =mmu_translate(addr,paddr,refill);
-            if (info.hit==false) 
+            if (info.hit==false) {
                 isa_raise_intr(EC_TLBS, addr, refill);
-            if (info.dirty==false)
+                return false;
+            }
+            if (info.dirty==false) {
                 isa_raise_intr(EC_Mod, addr, refill);
+                return false;
+            }
             break;
                            }
         case MMU_FAIL:
             isa_raise_intr(EC_AdES, addr);
-            break;
+            return false;
     }
     //TODO: Bus Error Exception
     paddr_write(paddr, len, data);
+    IFDEF(CONFIG_SOFT_TLB, stlb_fill(addr, paddr, true));
+    return true;
+}
+
+#ifdef CONFIG_SOFT_TLB
+void CPU_state::stlb_fill(vaddr_t addr, paddr_t paddr, bool write) {
+    uint8_t* host = paddr_top->get_host_ptr(paddr);
+    if (host == nullptr) return;
+    if (!write) stlb.fill_read(addr, host);
+    // stores to code pages must reach the write hook of Pmem
+    else if (!MUXDEF(CONFIG_DECODE_CACHE, dcache.has_page(host), false)) stlb.fill_write(addr, host);
 }
+#endif
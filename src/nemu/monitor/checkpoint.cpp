@@ -0,0 +1,156 @@
+#include "common.hpp"
+#ifdef CONFIG_CHECKPOINT
+#include "nemu/checkpoint.hpp"
+#include "nemu/isa.hpp"
+#include "snapshot.hpp"
+#include "soc.hpp"
+#include "utils.hpp"
+#include <fmt/core.h>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+extern std::unique_ptr<dual_soc> soc;
+extern uint64_t ticks;
+
+static const char head_magic[8] = {'H', 'I', 'T', 'D', 'C', 'K', 'P', 'T'};
+static const char tail_magic[8] = {'H', 'I', 'T', 'D', 'C', 'E', 'N', 'D'};
+#define CKPT_VERSION 1
+#define CKPT_PAGE 4096
+#define CKPT_NO_PAGE 0xffffffffu    // ends the pages of a region
+
+/*
+ * head, CPU and device state, then for every memory region its head and
+ * (page, 4096 bytes) of each non-zero page up to CKPT_NO_PAGE, then the tail
+ */
+struct ckpt_head {
+    char magic[8];
+    uint32_t version;
+    uint32_t nr_region;
+    uint64_t ticks;
+    uint32_t state_len;
+    uint32_t pad;
+};
+struct ckpt_region {
+    word_t paddr;
+    uint32_t nr_page;
+};
+
+static const uint8_t zero_page[CKPT_PAGE] = {};
+
+bool checkpoint_save(const char* filename){/*{{{*/
+    PaddrTop* top = soc->get_dut_soc();
+    auto regions = top->mem_regions();
+    snap_writer state;
+    nemu->save_state(state);
+    top->save_state(state);
+
+    // write another file and rename it, a reader sees either file as a whole
+    std::string tmp = fmt::format("{}.{}", filename, getpid());
+    gzFile out = gzopen(tmp.c_str(), "wb1");
+    if (!out) {
+        nemu->log_pt->error("checkpoint fail to create %v", tmp);
+        return false;
+    }
+    auto put = [&](const void* data, size_t len) { return len == 0 || gzwrite(out, data, len) == (int)len; };
+    ckpt_head h = {{}, CKPT_VERSION, (uint32_t)regions.size(), ticks, (uint32_t)state.size(), 0};
+    memcpy(h.magic, head_magic, sizeof(head_magic));
+    bool res = put(&h, sizeof(h)) && put(state.data().data(), state.size());
+    size_t nr_saved = 0;
+    for (auto& r: regions) {
+        ckpt_region rh = {r.paddr, (uint32_t)(r.pmem->get_mem_size() / CKPT_PAGE)};
+        const uint8_t* mem = r.pmem->get_mem_ptr();
+        res = res && put(&rh, sizeof(rh));
+        for (uint32_t p = 0; res && p < rh.nr_page; p++) {
+            if (memcmp(mem + p * CKPT_PAGE, zero_page, CKPT_PAGE) == 0) continue;
+            res = put(&p, sizeof(p)) && put(mem + p * CKPT_PAGE, CKPT_PAGE);
+            nr_saved++;
+        }
+        uint32_t end = CKPT_NO_PAGE;
+        res = res && put(&end, sizeof(end));
+    }
+    res = res && put(tail_magic, sizeof(tail_magic));
+    res &= gzclose(out) == Z_OK;
+    res = res && rename(tmp.c_str(), filename) == 0;
+    if (!res) {
+        nemu->log_pt->error("checkpoint fail to write %v", filename);
+        remove(tmp.c_str());
+        return false;
+    }
+    nemu->log_pt->info("checkpoint of tick %v saved to %v, %v pages", ticks, filename, nr_saved);
+    return true;
+}/*}}}*/
+
+bool checkpoint_load(const char* filename){/*{{{*/
+    gzFile in = gzopen(filename, "rb");
+    if (!in) {
+        nemu->log_pt->error("checkpoint %v not exist", filename);
+        return false;
+    }
+    gzbuffer(in, 1 << 17);
+    std::string data;
+    static char buf[1 << 20];
+    int len;
+    while ((len = gzread(in, buf, sizeof(buf))) > 0) data.append(buf, len);
+    bool read_ok = len == 0;
+    gzclose(in);
+
+    // check the whole file before the machine is changed
+    PaddrTop* top = soc->get_dut_soc();
+    auto regions = top->mem_regions();
+    std::vector<std::vector<const uint8_t*>> pages(regions.size());
+    snap_reader rd(data.data(), data.size());
+    ckpt_head h;
+    rd.get(h);
+    const uint8_t* state = rd.take(rd.ok() ? h.state_len : 0);
+    const char* error = nullptr;
+    if (!read_ok || !rd.ok() || memcmp(h.magic, head_magic, sizeof(head_magic)) || h.version != CKPT_VERSION)
+        error = "is not a checkpoint of this version";
+    else if (h.nr_region != regions.size()) error = "has another memory map";
+    for (size_t i = 0; !error && i < regions.size(); i++) {
+        ckpt_region rh = {0, 0};
+        rd.get(rh);
+        if (rh.paddr != regions[i].paddr || rh.nr_page != regions[i].pmem->get_mem_size() / CKPT_PAGE) {
+            error = "has another memory map";
+            break;
+        }
+        pages[i].resize(rh.nr_page);
+        uint32_t p = 0;
+        while (rd.get(p) && p != CKPT_NO_PAGE) {
+            if (p >= rh.nr_page) break;
+            pages[i][p] = rd.take(CKPT_PAGE);
+        }
+        if (!rd.ok() || p != CKPT_NO_PAGE) error = "is not complete";
+    }
+    const uint8_t* tail = error ? nullptr : rd.take(sizeof(tail_magic));
+    if (!error && (!tail || memcmp(tail, tail_magic, sizeof(tail_magic)) || rd.left()))
+        error = "is not complete";
+    if (error) {
+        nemu->log_pt->error("checkpoint %v %v", filename, error);
+        return false;
+    }
+
+    // the CPU refuses a state of another version before it changes anything
+    snap_reader st(state, h.state_len);
+    if (!nemu->load_state(st)) return false;
+    if (!top->load_state(st)) {
+        nemu->log_pt->error("checkpoint %v has devices of another SoC, nemu is left half restored", filename);
+        nemu_state.state = NEMU_ABORT;
+        return false;
+    }
+    // only the pages that differ, the write hook drops their decoded instructions
+    for (size_t i = 0; i < regions.size(); i++) {
+        const uint8_t* mem = regions[i].pmem->get_mem_ptr();
+        for (size_t p = 0; p < pages[i].size(); p++) {
+            const uint8_t* want = pages[i][p] ? pages[i][p] : zero_page;
+            if (memcmp(mem + p * CKPT_PAGE, want, CKPT_PAGE))
+                regions[i].pmem->restore(p * CKPT_PAGE, want, CKPT_PAGE);
+        }
+    }
+    ticks = h.ticks;
+    if (nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
+    nemu->log_pt->info(fmt::format("checkpoint {} restored at tick {}, pc " HEX_WORD, filename, ticks, nemu->arch_state.pc));
+    return true;
+}/*}}}*/
+#endif
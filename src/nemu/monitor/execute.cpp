@@ -3,19 +3,29 @@
 #include "easylogging++.h"
 #include "fmt/core.h"
 #include "nemu/isa.hpp"
+#include "sdb/sdb.hpp"
 #include "soc.hpp"
 #include <csignal>
 bool g_si_print = false;
 void compare_exec(uint64_t n) {
   extern std::unique_ptr<dual_soc> soc;
-  for (; n > 0; n--) {
+  while (n > 0) {
     // TIMED_SCOPE(exec_once, "compare exec once");
     extern uint64_t ticks;
     ++ticks;
     // if (ticks==208845297) raise(SIGTRAP);
     soc->tick();
     nemu->ref_tick_and_int(soc->dut_ext_int());
-    nemu->exec_once();
+    // a jit run skips the break and watch points of the pcs inside it
+    bool step = g_si_print || MUXDEF(CONFIG_WATCH_POINT, has_wp(), false);
+    int retired = nemu->exec_once(step ? 1 : n);
+    // a jit run touches registers only, tick for the rest of it afterwards
+    for (int i = 1; i < retired; i++) {
+      ++ticks;
+      soc->tick();
+      nemu->ref_tick_and_int(soc->dut_ext_int());
+    }
+    n -= retired;
     if (g_si_print)
       fmt::print(
           HEX_WORD ":\t{}\n", nemu->arch_state.pc,
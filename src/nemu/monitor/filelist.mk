@@ -1,4 +1,5 @@
 DIRS-y += src/nemu/monitor/sdb
 SRCS-y += src/nemu/monitor/execute.cpp
 SRCS-y += src/nemu/monitor/monitor.cpp
+SRCS-$(CONFIG_CHECKPOINT) += src/nemu/monitor/checkpoint.cpp
 DIRS-$(CONFIG_DWARF) += src/nemu/monitor/dwarf
@@ -17,6 +17,7 @@
 #include "soc.hpp"
 #include "utils.hpp"
 #include "nemu/cpu/difftest.hpp"
+#include "nemu/checkpoint.hpp"
 #include <memory>
 extern uint64_t ticks ;
 extern uint32_t log_pc ;
@@ -76,6 +77,12 @@ void init_monitor(int argc, char *argv[]) {
   /* Initialize differential testing. */
   IFDEF(CONFIG_DIFFTEST, init_difftest(cemu_paddr));
 
+  /* Restore the checkpoint, a broken one ends the run. */
+#ifdef CONFIG_CHECKPOINT
+  extern const char* arg_ckpt_load;
+  if (*arg_ckpt_load && !checkpoint_load(arg_ckpt_load)) nemu_state.state = NEMU_ABORT;
+#endif
+
   /* Initialize the simple debugger. */
   init_sdb();
 
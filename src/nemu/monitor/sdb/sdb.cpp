@@ -27,6 +27,7 @@
 #include "sdb.hpp"
 #include "utils.hpp"
 #include "nemu/Debugger.hpp"
+#include "nemu/checkpoint.hpp"
 
 /* We use the `readline' library to provide more flexibility to read from stdin. */
 static char* rl_gets() {/*{{{*/
@@ -301,6 +302,34 @@ static int cmd_l(char *args){
     return 0;
 }
 
+static int cmd_save(char *args){/*{{{*/
+#ifdef CONFIG_CHECKPOINT
+    char *file = args ? strtok(NULL, " ") : NULL;
+    if (file && strtok(NULL, " ") == NULL) {
+        if (checkpoint_save(file)) fmt::print("checkpoint saved to {}\n", file);
+        else fmt::print("fail to save checkpoint to {}\n", file);
+    }
+    else print_description("save");
+#else 
+    printf("checkpoint not enable, please first enable it by \"make memuconfig\"\n");
+#endif 
+    return 0;
+}/*}}}*/
+
+static int cmd_load(char *args){/*{{{*/
+#ifdef CONFIG_CHECKPOINT
+    char *file = args ? strtok(NULL, " ") : NULL;
+    if (file && strtok(NULL, " ") == NULL) {
+        if (checkpoint_load(file)) fmt::print("checkpoint {} loaded, pc " HEX_WORD "\n", file, nemu->arch_state.pc);
+        else fmt::print("fail to load checkpoint {}\n", file);
+    }
+    else print_description("load");
+#else 
+    printf("checkpoint not enable, please first enable it by \"make memuconfig\"\n");
+#endif 
+    return 0;
+}/*}}}*/
+
 static struct {/*{{{*/
   const char *name;
   const char *description;
@@ -322,6 +351,8 @@ cmd_table [] = {/*{{{*/
     { "b",    "set break point by \"b [addr]|[function name]\"",            cmd_b   },  
     { "fin",  "return current function by \"fin\"",                         cmd_fin },  
     { "l",    "list source code arrounded by \"l [up] [down]\"",            cmd_l   },  
+    { "save", "save the whole machine to a checkpoint by \"save [file]\"",  cmd_save},
+    { "load", "restore the checkpoint by \"load [file]\"",                  cmd_load},
     { "help", "Display information about all supported commands",           cmd_help},
 
 };/*}}}*/
@@ -360,6 +391,11 @@ static int cmd_help(char *args) {/*{{{*/
 
 void sdb_mainloop() {/*{{{*/
     extern bool arg_batch_mode;
+#ifdef CONFIG_CHECKPOINT
+    extern const char* arg_ckpt_save;
+    extern uint64_t arg_ckpt_at;
+    if (*arg_ckpt_save && cpu_exec(arg_ckpt_at)) checkpoint_save(arg_ckpt_save);
+#endif
     if (arg_batch_mode) {
         cmd_c(NULL);
         return;
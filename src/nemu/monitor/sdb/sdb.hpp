@@ -24,6 +24,7 @@ word_t expr(char *e, bool *success);
 bool new_wp(char* expression);
 bool new_br(word_t br_pc, const char* info);
 bool free_node(int number);
+bool has_wp();
 bool is_wp_change();
 void print_wp_info();
 
@@ -101,6 +101,10 @@ bool free_node(int number){/*{{{*/
     return res;
 }/*}}}*/
 
+bool has_wp(){/*{{{*/
+    return head!=NULL;
+}/*}}}*/
+
 bool is_wp_change(){/*{{{*/
     bool is_change = false;
     debug_point* tmp = head;
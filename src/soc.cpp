@@ -2,6 +2,7 @@
 #include "debug.hpp"
 #include "macro.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <csignal>
 #include <cstdio>
 #include "path.hh"
@@ -61,6 +62,10 @@ static std::tuple<PaddrTop*, Puart8250*> kernel_soc() {/*{{{*/
 }/*}}}*/
 
 dual_soc::dual_soc() {/*{{{*/
+    IFDEF(CONFIG_REF_TRACE, echo = nullptr);
+    IFDEF(CONFIG_WAVE_ON, watch = nullptr);
+    // only the uart drives the interrupt line, a confreg-only SoC keeps it low
+    ext_int[DUT] = ext_int[REF] = 0;
     IFDEF(CONFIG_BASIC_SOC, create_basic_soc());
     IFDEF(CONFIG_BOOT_SOC, create_boot_soc());
     IFDEF(CONFIG_KERNEL_SOC, create_kernel_soc());
@@ -107,7 +112,7 @@ void single_soc::create_kernel_soc(){/*{{{*/
 
 #define UART_CHAR "'{:c}'({:#x})"
 
-void loop_check(output* dut, output* ref){/*{{{*/
+void loop_check(output* dut, output* ref, std::string* echo, std::string* watch){/*{{{*/
     bool normal = true;
     char ref_c = ref->getc();
     if (ref->exist_tx()) {
@@ -133,13 +138,15 @@ void loop_check(output* dut, output* ref){/*{{{*/
     if (normal) {
         putchar(ref_c);
         fflush(stdout);
+        if (echo) echo->push_back(ref_c);
+        if (watch) watch->push_back(ref_c);
     }
     IFDEF(CONFIG_NEED_NEMU,else nemu_state.state = NEMU_ABORT);
 }/*}}}*/
 
-void chech_output(output* dut, output* ref){/*{{{*/
+void chech_output(output* dut, output* ref, std::string* echo = nullptr, std::string* watch = nullptr){/*{{{*/
 #ifdef CONFIG_DIFFTEST
-    if (unlikely(ref->exist_tx())) loop_check(dut,ref);
+    if (unlikely(ref->exist_tx())) loop_check(dut,ref,echo,watch);
     else if (unlikely(dut->exist_tx())){
             dut->op_log->error(fmt::format("should not output " UART_CHAR,
                 dut->getc(),dut->getc()));
@@ -147,16 +154,20 @@ void chech_output(output* dut, output* ref){/*{{{*/
     }
 #else
     while (dut->exist_tx()) {
-        putchar(dut->getc());
+        char c = dut->getc();
+        putchar(c);
         fflush(stdout);
+        if (watch) watch->push_back(c);
     }
 #endif 
 }/*}}}*/
 
 void dual_soc::tick(){ /*{{{*/
     IFDEF(CONFIG_HAS_CONFREG, pcfreg[DUT]->tick();pcfreg[REF]->tick();)
-    IFDEF(CONFIG_HAS_CONFREG, chech_output(pcfreg[DUT], pcfreg[REF]));
-    IFDEF(CONFIG_HAS_UART, chech_output(puart[DUT], puart[REF]));
+    IFDEF(CONFIG_HAS_CONFREG, chech_output(pcfreg[DUT], pcfreg[REF], \
+                MUXDEF(CONFIG_REF_TRACE, echo, nullptr), MUXDEF(CONFIG_WAVE_ON, watch, nullptr)));
+    IFDEF(CONFIG_HAS_UART, chech_output(puart[DUT], puart[REF], \
+                MUXDEF(CONFIG_REF_TRACE, echo, nullptr), MUXDEF(CONFIG_WAVE_ON, watch, nullptr)));
     IFDEF(CONFIG_HAS_UART, ext_int[DUT] = puart[DUT]->irq() << 1); 
     IFDEF(CONFIG_HAS_UART, ext_int[REF] = puart[REF]->irq() << 1); 
 #ifdef CONFIG_HAS_UART
@@ -186,6 +197,76 @@ void dual_soc::tick(){ /*{{{*/
 #endif
 #endif
 }/*}}}*/
+#ifdef CONFIG_REF_THREAD
+static void drain_output(output* dev, std::string& out, bool print, std::string* watch = nullptr){/*{{{*/
+    while (dev->exist_tx()) {
+        char c = dev->getc();
+        out.push_back(c);
+        if (print) putchar(c);
+        if (watch) watch->push_back(c);
+    }
+    if (print) fflush(stdout);
+}/*}}}*/
+void dual_soc::tick_dut(){/*{{{*/
+    IFDEF(CONFIG_HAS_CONFREG, pcfreg[DUT]->tick(); drain_output(pcfreg[DUT], out[DUT], true, MUXDEF(CONFIG_WAVE_ON, watch, nullptr)));
+    IFDEF(CONFIG_HAS_UART, drain_output(puart[DUT], out[DUT], true, MUXDEF(CONFIG_WAVE_ON, watch, nullptr)));
+    IFDEF(CONFIG_HAS_UART, ext_int[DUT] = puart[DUT]->irq() << 1);
+}/*}}}*/
+void dual_soc::tick_ref(){/*{{{*/
+    IFDEF(CONFIG_HAS_CONFREG, pcfreg[REF]->tick(); drain_output(pcfreg[REF], out[REF], false));
+    IFDEF(CONFIG_HAS_UART, drain_output(puart[REF], out[REF], false));
+    IFDEF(CONFIG_HAS_UART, ext_int[REF] = puart[REF]->irq() << 1);
+}/*}}}*/
+#ifdef CONFIG_HAS_UART
+uint64_t dual_soc::uart_regs(soc_who who){/*{{{*/
+    Puart8250* uart = puart[who];
+    return (uint64_t)uart->DLL | (uint64_t)uart->DLM << 8 | (uint64_t)uart->IER << 16 |
+        (uint64_t)uart->IIR << 24 | (uint64_t)uart->LCR << 32 | (uint64_t)uart->MCR << 40 |
+        (uint64_t)uart->rx.empty() << 48 | (uint64_t)uart->thr_empty << 56;
+}/*}}}*/
+#endif
+bool dual_soc::check_output(){/*{{{*/
+    size_t n = std::min(out[DUT].size(), out[REF].size());
+    size_t i = std::mismatch(out[DUT].begin(), out[DUT].begin() + n, out[REF].begin()).first - out[DUT].begin();
+    if (i == out[REF].size()) return true;
+    extern el::Logger *mycpu_log;
+    if (i == n) mycpu_log->error(fmt::format("should output " UART_CHAR " at char {} but not", out[REF][i], out[REF][i], i));
+    else mycpu_log->error(fmt::format("output " UART_CHAR " not equal to ref " UART_CHAR " at char {}",
+                out[DUT][i], out[DUT][i], out[REF][i], out[REF][i], i));
+    return false;
+}/*}}}*/
+#endif
+#if defined(CONFIG_GOLDEN_TRACE) || defined(CONFIG_REF_TRACE)
+static void print_output(output* dev, std::string* out, std::string* watch = nullptr){/*{{{*/
+    if (likely(!dev->exist_tx())) return;
+    while (dev->exist_tx()) {
+        char c = dev->getc();
+        putchar(c);
+        if (out) out->push_back(c);
+        if (watch) watch->push_back(c);
+    }
+    fflush(stdout);
+}/*}}}*/
+void dual_soc::tick_dut_alone(std::string* out){/*{{{*/
+    IFDEF(CONFIG_HAS_CONFREG, pcfreg[DUT]->tick(); print_output(pcfreg[DUT], out, MUXDEF(CONFIG_WAVE_ON, watch, nullptr)));
+    IFDEF(CONFIG_HAS_UART, print_output(puart[DUT], out, MUXDEF(CONFIG_WAVE_ON, watch, nullptr)));
+    IFDEF(CONFIG_HAS_UART, ext_int[DUT] = puart[DUT]->irq() << 1);
+}/*}}}*/
+#endif
+#ifdef CONFIG_REF_TRACE
+void dual_soc::tick_ref_alone(){/*{{{*/
+    IFDEF(CONFIG_HAS_CONFREG, pcfreg[REF]->tick());
+    drop_ref_output();
+    IFDEF(CONFIG_HAS_UART, ext_int[REF] = puart[REF]->irq() << 1);
+}/*}}}*/
+void dual_soc::drop_ref_output(){/*{{{*/
+    IFDEF(CONFIG_HAS_CONFREG, while (pcfreg[REF]->exist_tx()) pcfreg[REF]->getc());
+    IFDEF(CONFIG_HAS_UART, while (puart[REF]->exist_tx()) puart[REF]->getc());
+}/*}}}*/
+void dual_soc::shift_ref_time(int64_t delta){/*{{{*/
+    IFDEF(CONFIG_HAS_CONFREG, pcfreg[REF]->shift_timer(delta));
+}/*}}}*/
+#endif
 void dual_soc::set_switch(uint8_t value){/*{{{*/
     IFDEF(CONFIG_HAS_CONFREG, pcfreg[0]->set_switch(value); pcfreg[1]->set_switch(value);)
 }/*}}}*/
@@ -3,6 +3,7 @@
 #include "testbench/axi.hpp"
 #include "fmt/core.h"
 #include "testbench/sim_state.hpp"
+#include <algorithm>
 #include <vector>
 extern el::Logger* mycpu_log;
 
@@ -12,26 +13,63 @@ void axi_paddr::update_output(){
 }
 
 bool axi_paddr::calculate_output(){/*{{{*/
+    cycle++;
     bool res = read_eval();
     res &= write_eval();
     return res;
 }/*}}}*/
 
 void axi_paddr::reset(){/*{{{*/
-    r_status = r_idel;
+    cycle = 0;
+    delay->reset();
+    for (auto& t: r_txn) t.status = t_free;
+    for (auto& t: w_txn) t.status = t_free;
+    r_seq = w_seq = 0;
+    r_cur = w_back = -1;
+    r_rr = w_rr = NR_TXN - 1;
     idel_wait_read();
-    w_status = w_idel;
     idel_wait_write();
 }/*}}}*/
 
 void axi_paddr::set_diff_mem(PaddrTop* diff_mem){ check_paddr_top = diff_mem; }
 
+void axi_paddr::save_state(snap_writer& out){/*{{{*/
+#define __my_axi_out_save__(width,name,masterIn) IFONE(masterIn, out.put(s_##name);)
+    AXI_BUNDLE(__my_axi_out_save__)
+    out.put(cycle);
+    out.put(r_txn);
+    out.put(r_seq);
+    out.put(r_cur);
+    out.put(r_rr);
+    out.put(w_txn);
+    out.put(w_seq);
+    out.put(w_back);
+    out.put(w_rr);
+    delay->save_state(out);
+}/*}}}*/
+
+bool axi_paddr::load_state(snap_reader& in){/*{{{*/
+#define __my_axi_out_load__(width,name,masterIn) IFONE(masterIn, in.get(s_##name);)
+    AXI_BUNDLE(__my_axi_out_load__)
+    in.get(cycle);
+    in.get(r_txn);
+    in.get(r_seq);
+    in.get(r_cur);
+    in.get(r_rr);
+    in.get(w_txn);
+    in.get(w_seq);
+    in.get(w_back);
+    in.get(w_rr);
+    return delay->load_state(in) && in.ok();
+}/*}}}*/
+
 bool axi_paddr::check_axi_req(uint8_t num_bytes, burst_t burst_type, word_t start_addr, uint8_t burst_len){/*{{{*/
     bool res = true;
     __ASSERT_SIM__(num_bytes<=(CONFIG_AXI_DWID>>3), \
-            fmt::format("32 AXI read bytes number not support {}",num_bytes));
+            fmt::format("{} bit AXI bytes number not support {}",CONFIG_AXI_DWID,num_bytes));
     __ASSERT_SIM__(burst_type!=BURST_RESERVED, \
             "Arburst type is RESERVED");
+    __ASSERT_SIM__(burst_len<=16, "burst length {} is longer than 16", burst_len);
 
     word_t align_addr = start_addr & ~(num_bytes-1);
     bool aligned = start_addr==align_addr;
@@ -49,12 +87,22 @@ bool axi_paddr::check_axi_req(uint8_t num_bytes, burst_t burst_type, word_t star
     }//NOTE: FIX must not cross 4KB address bound
     return res;
 }/*}}}*/
-void axi_paddr::read_difftest(){/*{{{*/
-    word_t check_data;
-    check_paddr_top->do_read(r_cur_addr, r_cur_info, &check_data);
-    __ASSERT_SIM__(check_data==s_rdata, "read {} bytes at [" HEX_WORD "] is error !!!", (uint8_t)r_cur_info.size, r_cur_addr);
+void axi_paddr::read_difftest(const axi_txn& t){/*{{{*/
+    uint8_t check_data[sizeof(t.data)];
+    int size = t.info[0].size;
+    int total = t.burst_count * size;
+    check_paddr_top->burst_read(t.addr, t.info[0], t.burst_count, t.burst_type, check_data);
+    if (likely(memcmp(check_data, t.data, total) == 0)) return;
+    // report the word holding the first different byte
+    int i = (std::mismatch(check_data, check_data + total, t.data).first - check_data) & ~3;
+    word_t ref = 0, my = 0;
+    int n = std::min(4, total - i);
+    memcpy(&ref, check_data + i, n);
+    memcpy(&my, t.data + i, n);
+    __ASSERT_SIM__(0, "read {} bytes at [" HEX_WORD "] is error !!!", size,
+            burst_beat_addr(t.addr, size, t.burst_count, t.burst_type, i / size) + i % size);
     extern void print_reg_diff(word_t ref, word_t my_ans, const char* name);
-    print_reg_diff(check_data, s_rdata, "mem");
+    print_reg_diff(ref, my, "mem");
 }/*}}}*/
 
 const char* burst_str(burst_t num){/*{{{*/
@@ -68,166 +116,159 @@ const char* burst_str(burst_t num){/*{{{*/
     return res;
 }/*}}}*/
 
-bool axi_paddr::accept_read_req(){/*{{{*/
-    bool res = true;
-    uint8_t num_bytes = 1 << pins.arsize;
+int axi_paddr::free_txn(const axi_txn* txn){/*{{{*/
+    for (int i = 0; i < NR_TXN; i++) {
+        if (txn[i].status == t_free) return i;
+    }
+    return -1;
+}/*}}}*/
 
-    r_burst_count = pins.arlen + 1;
-    word_t start_addr = pins.araddr;
-    r_burst_type = (burst_t)pins.arburst;
+// next txn in status to answer after rr: ready and the oldest of its ID, -1 if none
+int axi_paddr::pick_txn(const axi_txn* txn, tstatus_t status, int& rr){/*{{{*/
+    for (int k = 1; k <= NR_TXN; k++) {
+        int i = (rr + k) % NR_TXN;
+        const axi_txn& t = txn[i];
+        if (t.status != status || t.ready_at > cycle) continue;
+        bool oldest = true;
+        for (int j = 0; j < NR_TXN; j++) {
+            oldest &= !(txn[j].status != t_free && txn[j].id == t.id && txn[j].seq < t.seq);
+        }
+        if (oldest) return rr = i;
+    }
+    return -1;
+}/*}}}*/
 
-    check_axi_req(num_bytes, r_burst_type, start_addr, r_burst_count);
+void axi_paddr::init_txn(axi_txn& t, uint8_t id, uint8_t size_bits, uint8_t len, uint8_t burst, word_t start_addr){/*{{{*/
+    uint8_t num_bytes = 1 << size_bits;
+    t.id = id;
+    t.burst_count = len + 1;
+    t.burst_type = (burst_t)burst;
+    t.cur_NO = 0;
+    t.ready_at = -1;
+    check_axi_req(num_bytes, t.burst_type, start_addr, t.burst_count);
 
-    if (r_burst_type==BURST_WRAP){
-        r_wrap_off_mask = ((r_burst_count)<<pins.arsize)-1;
-        r_wrap_bound = start_addr & ~r_wrap_off_mask;
-        r_wrap_offset = (start_addr & r_wrap_off_mask) >> pins.arsize;
+    if (t.burst_type==BURST_WRAP){
+        word_t wrap_off_mask = ((t.burst_count)<<size_bits)-1;
+        t.wrap_offset = (start_addr & wrap_off_mask) >> size_bits;
     }
-    else r_wrap_offset = 0;
+    else t.wrap_offset = 0;
 
-    r_cur_id = pins.arid;
-    r_cur_addr = start_addr;
-    r_cur_info.size = num_bytes;
-    r_cur_info.wstrb = 0xf;
-    r_cur_NO = 0;
+    t.addr = start_addr;
+    for (auto& info: t.info) {
+        info.size = num_bytes;
+        info.wstrb = (1u << num_bytes) - 1;
+    }
+}/*}}}*/
 
-    r_left_time = rand_delay();
-    s_arready = 0;
+bool axi_paddr::accept_read_req(){/*{{{*/
+    bool res = true;
+    int idx = free_txn(r_txn);
+    axi_txn& t = r_txn[idx];
+    init_txn(t, pins.arid, pins.arsize, pins.arlen, pins.arburst, pins.araddr);
+    t.status = t_req_ok;
+    t.seq = r_seq++;
+    t.ready_at = cycle + 1 + delay->read_delay(cycle, pins.araddr, t.burst_count);
     paddr_top->log_pt->trace(fmt::format("[T] read  req [" HEX_WORD "], size={}, len={}, burst={}, id={}", 
-                start_addr, num_bytes, r_burst_count, burst_str(r_burst_type), r_cur_id));
+                pins.araddr, (uint8_t)t.info[0].size, t.burst_count, burst_str(t.burst_type), t.id));
     return res;
-} // check axi, assign last_count, assign left_time, unset arready }}}
+} // check axi and compute when the first beat is ready }}}
 bool axi_paddr::do_once_read(){/*{{{*/
-    bool res = true;
-    res = paddr_top->do_read(r_cur_addr, r_cur_info, &s_rdata);
-    IFDEF(CONFIG_MEM_DIFF, read_difftest();)
-    r_cur_data[r_cur_NO++] = s_rdata;
-    s_rvalid = 1;
-    s_rlast = r_burst_count==r_cur_NO;
-    s_rid = r_cur_id;
-    s_rresp = res ? RESP_OKEY : RESP_DECERR;
-
-    switch (r_burst_type) {
-        case BURST_FIXED:
-            break;
-        case BURST_INCR:
-            r_cur_addr += r_cur_info.size;
-            break;
-        case BURST_WRAP:
-            r_cur_addr = ((r_cur_addr + r_cur_info.size) & r_wrap_off_mask) | r_wrap_bound;
-            break;
-        default:
-            assert(0);
+    axi_txn& t = r_txn[r_cur];
+    if (t.cur_NO == 0) {
+        t.ok = paddr_top->burst_read(t.addr, t.info[0], t.burst_count, t.burst_type, t.data);
+        IFDEF(CONFIG_MEM_DIFF, if (check_paddr_top) read_difftest(t);)
     }
-    return res;
-} // check axi, last_count--, assign axi R channel valid}}}
+    int size = t.info[0].size;
+    word_t beat_addr = burst_beat_addr(t.addr, size, t.burst_count, t.burst_type, t.cur_NO);
+    memset(&s_rdata, 0, sizeof(s_rdata));
+    memcpy((uint8_t*)&s_rdata + beat_lane(beat_addr, size), t.data + t.cur_NO * size, size);
+    t.cur_NO++;
+    s_rvalid = 1;
+    s_rlast = t.burst_count==t.cur_NO;
+    s_rid = t.id;
+    s_rresp = t.ok ? RESP_OKEY : RESP_DECERR;
+    return t.ok;
+} // the whole burst is read with its first beat, assign axi R channel valid}}}
 void axi_paddr::idel_wait_read(){/*{{{*/
     s_rvalid = 0;
     s_rresp = 0;
     s_rid = 0;
     s_rlast = 0;
-    s_rdata = 0;
+    memset(&s_rdata, 0, sizeof(s_rdata));
     s_arready = 1;
 };/*}}}*/
 bool axi_paddr::read_eval(){/*{{{*/
     bool res = true;
-    switch (r_status) {
-        case r_idel: 
-            if (pins.arvalid){
-                r_status = r_req_ok;
-                res &= accept_read_req();
-            }
-            break;
-        case r_req_ok:
-            if (r_left_time) r_left_time--;
-            else {
-                r_status = r_wait_last;
-                res &= do_once_read();
-            }
-            break;
-        case r_wait_last:
-            if (pins.rready){
-                if (pins.rlast){
-                    r_status = r_idel;
-                    idel_wait_read();
-                    read_data_trace();
-                }
-                else res &= do_once_read();
-            }
-            break;
+    // handshakes of the cycle ending at this edge
+    if (s_rvalid && pins.rready){
+        axi_txn& t = r_txn[r_cur];
+        s_rvalid = 0;
+        if (s_rlast){
+            read_data_trace(t);
+            t.status = t_free;
+            r_cur = -1;
+        }
+        else if (!MUXDEF(CONFIG_AXI_INTERLEAVE, true, false)) res &= do_once_read();
+    }
+    if (s_arready && pins.arvalid) res &= accept_read_req();
+    s_arready = free_txn(r_txn) >= 0;
+    // beat for the next cycle, interleaved across IDs
+    if (!s_rvalid){
+        int next = pick_txn(r_txn, t_req_ok, r_rr);
+        if (next >= 0){
+            r_cur = next;
+            res &= do_once_read();
+        }
+        else {
+            s_rlast = 0;
+            s_rid = 0;
+        }
     }
     return res;
 }/*}}}*/
 
 bool axi_paddr::accept_write_req(){/*{{{*/
     bool res = true;
-    uint8_t num_bytes = 1 << pins.awsize;
-
-    w_burst_count = pins.awlen + 1;
-    word_t start_addr = pins.awaddr;
-    w_burst_type = (burst_t)pins.awburst;
-
-    check_axi_req(num_bytes, w_burst_type, start_addr, w_burst_count);
-
-    if (w_burst_type==BURST_WRAP){
-        w_wrap_off_mask = ((w_burst_count)<<pins.awsize)-1;
-        w_wrap_bound = start_addr & ~w_wrap_off_mask;
-        w_wrap_offset = (start_addr & w_wrap_off_mask) >> pins.awsize;
-    }
-    else w_wrap_offset = 0;
-
-    w_cur_NO = 0;
-    w_cur_id = pins.awid;
-    w_cur_addr[w_cur_NO] = start_addr;
-    w_cur_info[w_cur_NO].size = num_bytes;
-    s_awready = 0;
-    s_wready = 1;
-
+    int idx = free_txn(w_txn);
+    axi_txn& t = w_txn[idx];
+    init_txn(t, pins.awid, pins.awsize, pins.awlen, pins.awburst, pins.awaddr);
+    t.status = t_req_ok;
+    t.seq = w_seq++;
     paddr_top->log_pt->trace(fmt::format("[T] write req [" HEX_WORD "] size={}, len={}, burst={}, id={}", 
-                start_addr, num_bytes, w_burst_count, burst_str(w_burst_type), w_cur_id));
+                pins.awaddr, (uint8_t)t.info[0].size, t.burst_count, burst_str(t.burst_type), t.id));
     return res;
 };/*}}}*/
 bool axi_paddr::accept_write_data(){/*{{{*/
     bool res = true;
-    __ASSERT_SIM__(pins.wid==w_cur_id, "Write data %x wid(%x) != awid(%x)",pins.wdata, pins.wid, w_cur_id);
-    w_cur_data[w_cur_NO] = pins.wdata;
-    w_cur_info[w_cur_NO].wstrb = pins.wstrb;
-    w_cur_NO++;
-    if (w_cur_NO == w_burst_count) {
-        __ASSERT_SIM__(pins.wlast==1, "Write data %x wlast != 1 when the last wdata arrive",pins.wdata);
-        s_wready = 0;
-        w_left_time = rand_delay();
-        write_data_trace();
+    // write data come in the order of their requests
+    int idx = -1;
+    for (int i = 0; i < NR_TXN; i++) {
+        const axi_txn& t = w_txn[i];
+        if (t.status == t_req_ok && (idx < 0 || t.seq < w_txn[idx].seq)) idx = i;
     }
-    else {
-        __ASSERT_SIM__(pins.wlast==0, "Write data %x wlast is set but not the last transition",pins.wdata);
-        word_t last_addr = w_cur_addr[w_cur_NO-1];
-        uint8_t last_size= w_cur_info[w_cur_NO-1].size;
-        w_cur_info[w_cur_NO].size = last_size;
-        switch (w_burst_type) {
-            case BURST_FIXED:
-                w_cur_addr[w_cur_NO] = last_addr;
-                break;
-            case BURST_INCR:
-                w_cur_addr[w_cur_NO] = last_addr + last_size;
-                break;
-            case BURST_WRAP:
-                w_cur_addr[w_cur_NO] = ((last_addr+last_size) & w_wrap_off_mask) | w_wrap_bound;
-                break;
-            default:
-                assert(0);
-        }
+    axi_txn& t = w_txn[idx];
+    int size = t.info[0].size;
+    word_t beat_addr = burst_beat_addr(t.addr, size, t.burst_count, t.burst_type, t.cur_NO);
+    __ASSERT_SIM__(pins.wid==t.id, "Write data [" HEX_WORD "] wid({:x}) != awid({:x})", beat_addr, pins.wid, t.id);
+    int lane = beat_lane(beat_addr, size);
+    memcpy(t.data + t.cur_NO * size, (const uint8_t*)&pins.wdata + lane, size);
+    t.info[t.cur_NO].wstrb = (uint32_t)pins.wstrb >> lane & (size < 4 ? 0xf : (1u << size) - 1);
+    t.cur_NO++;
+    if (t.cur_NO == t.burst_count) {
+        __ASSERT_SIM__(pins.wlast==1, "Write data [" HEX_WORD "] wlast != 1 when the last wdata arrive", beat_addr);
+        t.status = t_data_ok;
+        t.ready_at = cycle + 1 + delay->write_delay(cycle, t.addr, t.burst_count);
+        write_data_trace(t);
     }
+    else __ASSERT_SIM__(pins.wlast==0, "Write data [" HEX_WORD "] wlast is set but not the last transition", beat_addr);
     return res;
 };/*}}}*/
 bool axi_paddr::do_all_write(){/*{{{*/
-    bool res = true;
-    for (size_t i = 0; i < w_burst_count; i++) {
-        res &= paddr_top->do_write(w_cur_addr[i], w_cur_info[i], w_cur_data[i]);
-    }
+    const axi_txn& t = w_txn[w_back];
+    bool res = paddr_top->burst_write(t.addr, t.info, t.burst_count, t.burst_type, t.data);
     s_bvalid = 1;
     s_bresp = res ? RESP_OKEY : RESP_DECERR;
-    s_bid = w_cur_id;
+    s_bid = t.id;
     return res;
 };/*}}}*/
 void axi_paddr::idel_wait_write(){/*{{{*/
@@ -239,74 +280,59 @@ void axi_paddr::idel_wait_write(){/*{{{*/
 };/*}}}*/
 bool axi_paddr::write_eval(){/*{{{*/
     bool res = true;
-    switch (w_status) {
-        case w_idel:
-            if (pins.awvalid){
-                w_status = w_req_ok;
-                res &= accept_write_req();
-            }
-            break;
-        case w_req_ok:
-            if (pins.wvalid){
-                res &= accept_write_data();
-                w_status = pins.wlast ? w_data_ok : w_req_ok;
-            }
-            break;
-        case w_data_ok:
-            if (w_left_time) w_left_time--;
-            else {
-                w_status = w_wait_back;
-                res &= do_all_write();
-            }
-            break;
-        case w_wait_back:
-            if (pins.bready){
-                w_status = w_idel;
-                idel_wait_write();
-                paddr_top->log_pt->trace(fmt::format("[T] write finish id={}",w_cur_id));
-            }
-            break;
+    // handshakes of the cycle ending at this edge
+    if (s_bvalid && pins.bready){
+        paddr_top->log_pt->trace(fmt::format("[T] write finish id={}", w_txn[w_back].id));
+        w_txn[w_back].status = t_free;
+        w_back = -1;
+        s_bvalid = 0;
+        s_bid = 0;
+        s_bresp = 0;
+    }
+    if (s_wready && pins.wvalid) res &= accept_write_data();
+    if (s_awready && pins.awvalid) res &= accept_write_req();
+    s_awready = free_txn(w_txn) >= 0;
+    s_wready = false;
+    for (const auto& t: w_txn) s_wready |= t.status == t_req_ok;
+    // write back and response for the next cycle
+    if (!s_bvalid){
+        w_back = pick_txn(w_txn, t_data_ok, w_rr);
+        if (w_back >= 0) res &= do_all_write();
     }
     return res;
 }/*}}}*/
 
-void my_word_fmt(uint32_t data, wen_t info, std::stringstream &out){/*{{{*/
-    int width = info.size << 1;
-    char res[8] = {0};
-    for (size_t i = 0; i < width; i++) {
-        char tmp =  '\0';
-        if (info.wstrb & 0x1) {
-            char seg = data & 0xf;
-            if (seg < 10) tmp = 48 + seg;
-            else tmp = 87 + seg;
-        }
-        else tmp = '?';
-        res[width-1-i] = tmp;
-        info.wstrb = info.wstrb >> (i & 0x1);
-        data  = data  >> 4;
+void my_word_fmt(const uint8_t* bytes, wen_t info, std::stringstream &out){/*{{{*/
+    static const char hex[] = "0123456789abcdef";
+    char res[33] = {0};
+    for (int i = 0; i < info.size; i++) {
+        char* seg = res + (info.size - 1 - i) * 2;
+        bool en = info.wstrb >> i & 0x1;
+        seg[0] = en ? hex[bytes[i] >> 4] : '?';
+        seg[1] = en ? hex[bytes[i] & 0xf] : '?';
     }
     out << res;
 }/*}}}*/
-void axi_paddr::read_data_trace(){/*{{{*/
+void axi_paddr::read_data_trace(const axi_txn& t){/*{{{*/
     std::stringstream res;
     res << "[T] read  data ";
-    for (int i = 0; i < r_burst_count; i++) {
-        int index = (i + r_burst_count - r_wrap_offset) & (r_burst_count-1);
-        my_word_fmt(r_cur_data[index], r_cur_info, res);
+    for (int i = 0; i < t.burst_count; i++) {
+        int index = (i + t.burst_count - t.wrap_offset) % t.burst_count;
+        my_word_fmt(t.data + index * t.info[index].size, t.info[index], res);
         res <<" ";
     }
-    res << "id=" << std::to_string(r_cur_id);
+    res << "id=" << std::to_string(t.id);
     paddr_top->log_pt->trace(res.str());
 }/*}}}*/
-void axi_paddr::write_data_trace(){/*{{{*/
+void axi_paddr::write_data_trace(const axi_txn& t){/*{{{*/
     std::stringstream res;
     res << "[T] write data ";
-    for (int i = 0; i < w_burst_count; i++) {
-        int index = (i + w_burst_count - w_wrap_offset) & (w_burst_count-1);
-        my_word_fmt(w_cur_data[index], w_cur_info[index], res);
+    for (int i = 0; i < t.burst_count; i++) {
+        int index = (i + t.burst_count - t.wrap_offset) % t.burst_count;
+        my_word_fmt(t.data + index * t.info[index].size, t.info[index], res);
         res <<" ";
     }
-    res << "id=" << std::to_string(w_cur_id);
+    res << "id=" << std::to_string(t.id);
     paddr_top->log_pt->trace(res.str());
 }/*}}}*/
 
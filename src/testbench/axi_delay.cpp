@@ -0,0 +1,92 @@
+#include "testbench/axi_delay.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+// splitmix64, one per channel
+class prng {/*{{{*/
+    private:
+        uint64_t state;
+    public:
+        prng(uint64_t seed): state(seed) {}
+        uint64_t next() {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+};/*}}}*/
+
+class fixed_delay: public axi_delay {/*{{{*/
+    private:
+        int delay;
+    public:
+        fixed_delay(int _delay): delay(_delay) {}
+        int read_delay(uint64_t, word_t, int) override { return delay; }
+        int write_delay(uint64_t, word_t, int) override { return delay; }
+};/*}}}*/
+
+class random_delay: public axi_delay {/*{{{*/
+    private:
+        int min, range;
+        uint64_t seed;
+        prng r, w;
+    public:
+        random_delay(int _min, int _max, uint64_t _seed):
+            min(_min), range(_max - _min + 1), seed(_seed), r(_seed), w(~_seed) {}
+        int read_delay(uint64_t, word_t, int) override { return min + r.next() % range; }
+        int write_delay(uint64_t, word_t, int) override { return min + w.next() % range; }
+        void reset() override { r = prng(seed); w = prng(~seed); }
+        void save_state(snap_writer& out) override { out.put(r); out.put(w); }
+        bool load_state(snap_reader& in) override { return in.get(r) && in.get(w); }
+};/*}}}*/
+
+/*
+ * Open page DDR: a row buffer hit costs CL, an idle bank RCD + CL and a row
+ * conflict RP + RCD + CL. A bank is busy until the data of its last burst is
+ * out, a new burst to it waits for that first.
+ */
+class ddr_delay: public axi_delay {/*{{{*/
+    private:
+        static constexpr int NR_BANK = 8;
+        static constexpr int ROW_SHIFT = 13;
+        static constexpr word_t NO_ROW = -1;
+        int cl, rcd, rp;
+        word_t open_row[NR_BANK];
+        uint64_t busy_until[NR_BANK];
+        int access(uint64_t now, word_t addr, int len) {
+            int bank = (addr >> ROW_SHIFT) & (NR_BANK - 1);
+            word_t row = addr >> (ROW_SHIFT + 3);
+            int delay = cl;
+            if (open_row[bank] != row) delay += open_row[bank] == NO_ROW ? rcd : rp + rcd;
+            if (busy_until[bank] > now) delay += busy_until[bank] - now;
+            open_row[bank] = row;
+            busy_until[bank] = now + delay + len;
+            return delay;
+        }
+    public:
+        ddr_delay(int _cl, int _rcd, int _rp): cl(_cl), rcd(_rcd), rp(_rp) { reset(); }
+        int read_delay(uint64_t now, word_t addr, int len) override { return access(now, addr, len); }
+        int write_delay(uint64_t now, word_t addr, int len) override { return access(now, addr, len); }
+        void reset() override {
+            std::fill(open_row, open_row + NR_BANK, NO_ROW);
+            std::fill(busy_until, busy_until + NR_BANK, 0);
+        }
+        void save_state(snap_writer& out) override { out.put(open_row); out.put(busy_until); }
+        bool load_state(snap_reader& in) override { return in.get(open_row) && in.get(busy_until); }
+};/*}}}*/
+}
+
+std::unique_ptr<axi_delay> axi_delay::create(const std::string& spec, uint64_t seed){/*{{{*/
+    const char* s = spec.c_str();
+    int a, b, c;
+    char end;
+    if (spec == "zero") return std::unique_ptr<axi_delay>(new fixed_delay(0));
+    if (sscanf(s, "fixed:%d%c", &a, &end) == 1 && a >= 0)
+        return std::unique_ptr<axi_delay>(new fixed_delay(a));
+    if (sscanf(s, "random:%d:%d%c", &a, &b, &end) == 2 && 0 <= a && a <= b)
+        return std::unique_ptr<axi_delay>(new random_delay(a, b, seed));
+    if (sscanf(s, "ddr:%d:%d:%d%c", &a, &b, &c, &end) == 3 && a >= 0 && b >= 0 && c >= 0)
+        return std::unique_ptr<axi_delay>(new ddr_delay(a, b, c));
+    return nullptr;
+}/*}}}*/
@@ -9,6 +9,19 @@
 #include "soc.hpp"
 #include "testbench/cp0_checker.hpp"
 #include "testbench/inst_timer.hpp"
+#ifdef CONFIG_GOLDEN_TRACE
+#include "testbench/golden_trace.hpp"
+#endif
+#ifdef CONFIG_TEST_PERF
+#include "testbench/perf_score.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 INITIALIZE_EASYLOGGINGPP
 sim_status_t sim_status = SIM_RUN;
@@ -23,28 +36,174 @@ extern bool mainloop(
         std::string wave_name,
         dual_soc& soc
         );
+#ifdef CONFIG_GOLDEN_TRACE
+extern const char* arg_golden;
+extern bool golden_mainloop(
+        Vmycpu_top* top,
+        axi_paddr* axi,
+        std::string wave_name,
+        dual_soc& soc,
+        golden_trace& golden
+        );
+#endif
 
 void run_func(
         Vmycpu_top* top,
         axi_paddr* axi,
         dual_soc& soc
         ){/*{{{*/
+#ifdef CONFIG_GOLDEN_TRACE
+    if (*arg_golden) {
+        golden_trace golden;
+        soc.set_switch(0);
+        if (golden.open(arg_golden)) golden_mainloop(top, axi, "func-golden", soc, golden);
+        return;
+    }
+#endif
     for (size_t i = 0; i < 1; i++) {
         soc.set_switch(0);
         if (!mainloop(top, axi, "func-"+std::to_string(i), soc)) break;
     }
 }/*}}}*/
 
+#ifdef CONFIG_TEST_PERF
+static perf_result perf_once(
+        Vmycpu_top* top,
+        axi_paddr* axi,
+        dual_soc& soc,
+        uint32_t program
+        ){/*{{{*/
+    auto start = std::chrono::steady_clock::now();
+    soc.set_switch(program);
+    perf_result res;
+    res.program = program;
+    res.pass = mainloop(top, axi, "perf-"+std::to_string(program), soc);
+    res.cycles = ticks / 2;
+    res.num = soc.dut_num();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return res;
+}/*}}}*/
+
+// in the forked process: run one program and send the result to fd
+[[noreturn]] static void perf_worker(
+        Vmycpu_top* top,
+        axi_paddr* axi,
+        dual_soc& soc,
+        uint32_t program,
+        int fd
+        ){/*{{{*/
+    std::string name = "perf-" + std::to_string(program);
+    int out = open((name + ".log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out >= 0) {
+        dup2(out, STDOUT_FILENO);
+        dup2(out, STDERR_FILENO);
+        close(out);
+    }
+#ifdef CONFIG_TRACE
+    extern const char* arg_log_file;
+    el::Loggers::reconfigureAllLoggers(el::ConfigurationType::Filename, std::string(arg_log_file) + "." + name);
+#endif
+    perf_result res = perf_once(top, axi, soc, program);
+    bool ok = write(fd, &res, sizeof(res)) == sizeof(res);
+    nemu_log->flush();
+    mycpu_log->flush();
+    fflush(stdout);
+    _exit(ok ? 0 : 1);
+}/*}}}*/
+
+// fork one worker per program, at most jobs at the same time
+static void perf_fork(
+        Vmycpu_top* top,
+        axi_paddr* axi,
+        dual_soc& soc,
+        int jobs,
+        std::vector<perf_result>& results
+        ){/*{{{*/
+    std::map<pid_t, std::pair<uint32_t, int>> running;    // pid -> program, read end of its pipe
+    uint32_t next = CONFIG_PERF_START;
+    while (true) {
+        if (next <= CONFIG_PERF_END && (int)running.size() < jobs && sim_status != SIM_INT) {
+            int fd[2];
+            if (pipe(fd) != 0) {
+                mycpu_log->error("perf-%v fail to create pipe", next);
+                break;
+            }
+            nemu_log->flush();
+            mycpu_log->flush();
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fd[0]);
+                perf_worker(top, axi, soc, next, fd[1]);
+            }
+            close(fd[1]);
+            if (pid < 0) {
+                mycpu_log->error("perf-%v fail to fork", next);
+                close(fd[0]);
+                break;
+            }
+            mycpu_log->info("perf-%v runs in process %v", next, pid);
+            running[pid] = std::make_pair(next++, fd[0]);
+            continue;
+        }
+        if (running.empty()) break;
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        auto it = running.find(pid);
+        if (it == running.end()) continue;
+        perf_result res = {it->second.first, false, 0, 0, 0};
+        if (read(it->second.second, &res, sizeof(res)) != sizeof(res)) {
+            res = {it->second.first, false, 0, 0, 0};
+            if (WIFSIGNALED(status))
+                mycpu_log->error("perf-%v killed by signal %v", res.program, WTERMSIG(status));
+            else
+                mycpu_log->error("perf-%v exits with %v without result", res.program, WEXITSTATUS(status));
+        }
+        close(it->second.second);
+        running.erase(it);
+        results.push_back(res);
+    }
+    // nothing is left running if fork fails
+    for (auto& it: running) {
+        waitpid(it.first, NULL, 0);
+        close(it.second.second);
+    }
+    std::sort(results.begin(), results.end(), [](const perf_result& a, const perf_result& b){
+        return a.program < b.program;
+    });
+}/*}}}*/
+
 void run_perf(
         Vmycpu_top* top,
         axi_paddr* axi,
         dual_soc& soc
         ){/*{{{*/
-    for (size_t i = CONFIG_PERF_START; i <= CONFIG_PERF_END; i++) {
-        soc.set_switch(i);
-        if (!mainloop(top, axi, "perf-"+std::to_string(i), soc)) break;
+    extern int arg_jobs;
+    int nr_program = CONFIG_PERF_END - CONFIG_PERF_START + 1;
+    int jobs = arg_jobs > 0 ? arg_jobs : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = std::max(1, std::min(jobs, nr_program));
+    auto start = std::chrono::steady_clock::now();
+    std::vector<perf_result> results;
+    if (jobs == 1) {
+        for (size_t i = CONFIG_PERF_START; i <= CONFIG_PERF_END; i++) {
+            results.push_back(perf_once(top, axi, soc, i));
+            if (!results.back().pass) break;
+        }
     }
+    else perf_fork(top, axi, soc, jobs, results);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    perf_score score(results);
+    extern const char* arg_perf_baseline;
+    if (*arg_perf_baseline) score.load_baseline(arg_perf_baseline);
+    score.report(jobs, seconds);
+    score.save("perf-score");
 }/*}}}*/
+#endif
 
 void run_system(
         Vmycpu_top* top,
@@ -70,13 +229,24 @@ int main (int argc, char *argv[]) {
     Vmycpu_top* top = new Vmycpu_top();
     dpi_init();
     axi_paddr* axi = new axi_paddr(top);
+    extern const char* arg_axi_delay;
+    extern uint64_t arg_seed;
+    std::unique_ptr<axi_delay> delay = axi_delay::create(arg_axi_delay, arg_seed);
+    if (!delay) {
+        mycpu_log->error("unknown AXI delay model %v", arg_axi_delay);
+        return 1;
+    }
+    axi->set_delay(std::move(delay));
     axi->paddr_top = soc.get_dut_soc();
     axi->paddr_top->set_logger(mycpu_log);
 
-    PaddrTop* nemu_paddr_top = soc.get_ref_soc();
-    nemu_paddr_top->set_logger(nemu_log);
-    IFDEF(CONFIG_MEM_DIFF, axi->set_diff_mem(nemu_paddr_top));
-    init_isa(nemu_paddr_top);
+    // the golden trace takes the place of nemu
+    if (!MUXDEF(CONFIG_GOLDEN_TRACE, *arg_golden, false)) {
+        PaddrTop* nemu_paddr_top = soc.get_ref_soc();
+        nemu_paddr_top->set_logger(nemu_log);
+        IFDEF(CONFIG_MEM_DIFF, axi->set_diff_mem(nemu_paddr_top));
+        init_isa(nemu_paddr_top);
+    }
 
     IFDEF(CONFIG_TEST_FUNC, run_func(top, axi, soc));
     IFDEF(CONFIG_TEST_PERF, run_perf(top, axi, soc));
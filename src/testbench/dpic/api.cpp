@@ -10,3 +10,9 @@ void dpi_api_get_state(diff_state *mycpu){
 #endif 
     mycpu->pc = dpi_retirePC();
 }
+
+void dpi_api_get_commits(debug_info_t *commit, uint8_t commit_num){
+    for (uint8_t i = 0; i < commit_num; i++) {
+        dpi_get_commit(i, commit[i]);
+    }
+}
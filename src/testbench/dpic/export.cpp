@@ -15,6 +15,12 @@ uint8_t dpi_retire() { TODO(); }
 /* return the PC value of the last retire instruction in this cycle */
 uint32_t dpi_retirePC() { TODO(); }
 
+/* pass retire sequence (0 .. dpi_retire()-1, in program order) and get
+ * the commit record of that instruction in this cycle, wen is the byte
+ * strobe of wdata (bit i writes byte i, 0xf a whole word, as
+ * debug_wb_rf_wen of NSCSCC), 0 if it does not write a general register */
+void dpi_get_commit(uint8_t seq, debug_info_t &commit) { TODO(); }
+
 /* return the two regiter value: cat(hi,lo) */
 uint64_t dpi_get_hilo() { TODO(); }
 
@@ -0,0 +1,126 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_GOLDEN_TRACE
+#include "testbench/golden_trace.hpp"
+#include "testbench/sim_state.hpp"
+#include "easylogging++.h"
+#include <fmt/core.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern el::Logger* mycpu_log;
+static const char golden_magic[8] = {'H', 'I', 'T', 'D', 'G', 'O', 'L', 'D'};
+
+golden_trace::~golden_trace(){/*{{{*/
+    if (map) munmap(map, map_len);
+}/*}}}*/
+
+bool golden_trace::open(const std::string& filename){/*{{{*/
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        mycpu_log->error("golden trace %v not exist", filename);
+        return false;
+    }
+    name = filename;
+    std::string cache = filename + ".bin";
+    int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    if (load(cache, st.st_size, mtime)) return true;
+    mycpu_log->info("golden trace %v is parsed into %v", filename, cache);
+    return build(cache, st.st_size, mtime) && load(cache, st.st_size, mtime);
+}/*}}}*/
+
+bool golden_trace::load(const std::string& cache, uint64_t src_size, int64_t src_mtime){/*{{{*/
+    int fd = ::open(cache.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(head)) {
+        close(fd);
+        return false;
+    }
+    map_len = st.st_size;
+    map = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        map = nullptr;
+        return false;
+    }
+    const head* h = (const head*)map;
+    if (memcmp(h->magic, golden_magic, sizeof(golden_magic)) || h->version != 1 ||
+            h->src_size != src_size || h->src_mtime != src_mtime ||
+            map_len != sizeof(head) + (size_t)h->count * sizeof(rec)) {
+        munmap(map, map_len);
+        map = nullptr;
+        return false;
+    }
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    recs = (const rec*)(h + 1);
+    count = h->count;
+    pos = 0;
+    return true;
+}/*}}}*/
+
+bool golden_trace::build(const std::string& cache, uint64_t src_size, int64_t src_mtime){/*{{{*/
+    FILE* fp = fopen(name.c_str(), "r");
+    if (!fp) {
+        mycpu_log->error("golden trace fail to read %v", name);
+        return false;
+    }
+    std::vector<rec> out;
+    char buf[128];
+    uint32_t line = 0;
+    while (fgets(buf, sizeof(buf), fp)) {
+        line++;
+        char* p = buf;
+        char* end;
+        unsigned long field[4];
+        int n = 0;
+        for (; n < 4; n++, p = end) {
+            field[n] = strtoul(p, &end, 16);
+            if (end == p) break;
+        }
+        if (n == 0) continue;   // blank line
+        if (n != 4) {
+            mycpu_log->error("golden trace %v:%v is not \"flag pc wnum wdata\"", name, line);
+            fclose(fp);
+            return false;
+        }
+        if (!field[0]) continue;
+        out.push_back(rec{(word_t)field[1], (word_t)field[3], line, (uint8_t)field[2], {}});
+    }
+    fclose(fp);
+
+    // write another file and rename it, a reader sees either cache as a whole
+    std::string tmp = cache + fmt::format(".{}", getpid());
+    head h = {{}, 1, (uint32_t)out.size(), src_size, src_mtime};
+    memcpy(h.magic, golden_magic, sizeof(golden_magic));
+    fp = fopen(tmp.c_str(), "w");
+    bool res = fp && fwrite(&h, sizeof(h), 1, fp) == 1 &&
+        fwrite(out.data(), sizeof(rec), out.size(), fp) == out.size();
+    if (fp) res &= fclose(fp) == 0;
+    res = res && rename(tmp.c_str(), cache.c_str()) == 0;
+    if (!res) {
+        mycpu_log->error("golden trace fail to write %v", cache);
+        remove(tmp.c_str());
+    }
+    return res;
+}/*}}}*/
+
+bool golden_trace::check(const debug_info_t& commit){/*{{{*/
+    if (unlikely(pos == count)) {
+        __ASSERT_SIM__(0, "MyCPU commits pc " HEX_WORD " after the end of golden trace", commit.pc);
+        return false;
+    }
+    const rec& ref = recs[pos++];
+    word_t mask = wen_mask(commit.wen);
+    if (likely(commit.pc == ref.pc && commit.wnum == ref.wnum && (commit.wdata & mask) == ref.wdata)) return true;
+    __ASSERT_SIM__(0, "MyCPU commit is different from {} line {}", name, ref.line);
+    mycpu_log->error(fmt::format("  pc    " HEX_WORD " golden " HEX_WORD, commit.pc, ref.pc));
+    mycpu_log->error(fmt::format("  wnum  {:>10} golden {:>10}", commit.wnum, ref.wnum));
+    mycpu_log->error(fmt::format("  wdata " HEX_WORD " golden " HEX_WORD, commit.wdata & mask, ref.wdata));
+    return false;
+}/*}}}*/
+#endif
@@ -1,53 +1,83 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_PERF_ANALYSES
 #include "testbench/inst_timer.hpp"
+#include "easylogging++.h"
+#include <fmt/format.h>
+#include <algorithm>
 #include <cstdint>
-#include <memory>
-#include <fstream>
-#include <tuple>
+#include <cstdio>
+#include <iterator>
 
-inst_timer::inst_timer(AddrIntv _range): 
-    mask(_range.mask),
-    item_nr((mask+1)>>2),
-    data(std::make_unique<inst_info[]>(item_nr)) { }
+void inst_hist::add(consume_t cycles){/*{{{*/
+    min = runtime ? std::min(min, cycles) : cycles;
+    max = runtime ? std::max(max, cycles) : cycles;
+    ++runtime;
+    sum += cycles;
+    uint32_t whole = cycles;
+    int idx = whole ? 32 - __builtin_clz(whole) : 0;
+    ++bucket[std::min(idx, NR_BUCKET - 1)];
+}/*}}}*/
+
+#ifdef CONFIG_PERF_STREAM
+inst_timer::inst_timer(std::string filename):/*{{{*/
+    name(filename + ".bin"),
+    out((size_t)CONFIG_PERF_BUF_KB << 10) {
+    perf_head head = {{'H', 'I', 'T', 'D', 'P', 'E', 'R', 'F'}, 2, sizeof(perf_rec)};
+    if (!out.open(name, &head, sizeof(head))) LOG(ERROR) << "inst_timer fail to write " << name;
+}/*}}}*/
+
+void inst_timer::add_inst(Decode& inst_state, uint8_t asid, consume_t consumed_time, uint64_t ticks){/*{{{*/
+    perf_rec rec = {inst_state.pc | inst_state.is_delay_slot, (uint32_t)ticks, consumed_time/2, asid};
+    out.put(&rec, sizeof(rec));
+}/*}}}*/
 
-void inst_timer::add_inst(Decode& inst_state, consume_t consumed_time, uint64_t ticks){/*{{{*/
-    inst_info& info = data[pc2index(inst_state.pc)];
-    ++info.runtime;
-    info.consume += consumed_time;
-    info.verbose.push_back(std::make_tuple(ticks, consumed_time));
+bool inst_timer::save_date(){/*{{{*/
+    bool res = out.close();
+    if (!res) LOG(ERROR) << "inst_timer fail to write " << name;
+    return res;
+}/*}}}*/
+#else
+inst_timer::inst_timer(std::string filename): name(filename + ".hist") {}
+
+void inst_timer::add_inst(Decode& inst_state, uint8_t asid, consume_t consumed_time, uint64_t ticks){/*{{{*/
+    hist.at(inst_state.pc, asid).add(consumed_time/2);
     if (inst_state.is_delay_slot){
-        data[pc2index(inst_state.dnpc)].is_enter = true;
-        data[pc2index(inst_state.snpc)].is_enter = true;
+        hist.at(inst_state.dnpc, asid).is_enter = true;
+        hist.at(inst_state.snpc, asid).is_enter = true;
     }
 }/*}}}*/
 
-bool inst_timer::save_date(std::string filename){/*{{{*/
-        std::fstream outfile;
-        outfile.open(filename, std::fstream::out|std::fstream::trunc|std::fstream::binary);
-        bool res = outfile.is_open();
-        if (!res) LOG(ERROR) << "inst_timer fail to write " << filename;
-        else {
-            for (iindex_t index=0; index<=item_nr; index++) {
-                inst_info& it = data[index];
-                if (it.runtime){
-                    word_t pc = index2pc(index);
-                    outfile.write((char*)&pc, sizeof(word_t));
-                    outfile.write((char*)&(it.is_enter), sizeof(bool));
-                    outfile.write((char*)&(it.runtime), sizeof(runtime_t));
-                    // outfile << std::hex << index2pc(index)  << std::dec << "\t";
-                    // outfile << it.is_enter << "\t";
-                    // outfile << it.runtime << "\t";
-                    // outfile << "[";
-                    for (auto it: it.verbose) {
-                        consume_t consume = std::get<1>(it)/2;
-                        outfile.write((char*)&(std::get<0>(it)), sizeof(uint32_t));
-                        outfile.write((char*)&(consume), sizeof(consume_t));
-                        // outfile << "(" << std::get<0>(it) << ",";
-                        // outfile << std::get<1>(it) << ")";
-                    }
-                    // outfile << "]\n";
-                }
-            }
-            outfile.close();
+bool inst_timer::save_date(){/*{{{*/
+    FILE* fp = fopen(name.c_str(), "w");
+    if (!fp) {
+        LOG(ERROR) << "inst_timer fail to write " << name;
+        return false;
+    }
+    std::vector<size_t> order(hist.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b){
+        return std::make_pair(hist.asid_at(a), hist.pc_at(a)) < std::make_pair(hist.asid_at(b), hist.pc_at(b));
+    });
+    fmt::memory_buffer out;
+    fmt::format_to(std::back_inserter(out), "# asid pc enter runtime sum min max bucket[0..{})\n", inst_hist::NR_BUCKET);
+    for (size_t i: order) {
+        const inst_hist& it = hist.value_at(i);
+        // entered but never run, as a branch target after the end of the run
+        if (!it.runtime) continue;
+        fmt::format_to(std::back_inserter(out), "{:02x} {:08x} {:d} {} {:.1f} {} {}", hist.asid_at(i), hist.pc_at(i),
+                it.is_enter, it.runtime, it.sum, it.min, it.max);
+        for (auto n: it.bucket) fmt::format_to(std::back_inserter(out), " {}", n);
+        out.push_back('\n');
+        if (out.size() >= (1 << 20)) {
+            fwrite(out.data(), 1, out.size(), fp);
+            out.clear();
         }
-        return res;
-}    /*}}}*/
+    }
+    fwrite(out.data(), 1, out.size(), fp);
+    bool res = !ferror(fp);
+    res &= fclose(fp) == 0;
+    if (!res) LOG(ERROR) << "inst_timer fail to write " << name;
+    return res;
+}/*}}}*/
+#endif
+#endif
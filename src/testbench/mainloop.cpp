@@ -10,18 +10,39 @@
 #include "testbench/sim_state.hpp"
 #include "testbench/dpic.hpp"
 #include "testbench/cp0_checker.hpp"
+#ifdef CONFIG_SIG_DIFF
+#include "testbench/commit_sig.hpp"
+#include "disassemble.hpp"
+#endif
+#ifdef CONFIG_REF_THREAD
+#include "testbench/ref_thread.hpp"
+#include <memory>
+#endif
+#ifdef CONFIG_SIM_PROF
+#include "testbench/sim_prof.hpp"
+#endif
+#ifdef CONFIG_GOLDEN_TRACE
+#include "testbench/golden_trace.hpp"
+#endif
+#ifdef CONFIG_REF_TRACE
+#include "testbench/ref_trace.hpp"
+#endif
+#ifdef CONFIG_SIM_CKPT
+#include "testbench/sim_ckpt.hpp"
+#endif
 
-#define wave_file_t MUXDEF(CONFIG_EXT_FST,VerilatedFstC,VerilatedVcdC)
-#define __WAVE_INC__ MUXDEF(CONFIG_EXT_FST,"verilated_fst_c.h","verilated_vcd_c.h")
 #ifdef CONFIG_WAVE_ON
-#include __WAVE_INC__
+#include "testbench/wave_ctl.hpp"
 #endif
 
 extern uint64_t ticks;
+IFDEF(CONFIG_GOLDEN_TRACE, extern uint32_t log_pc);
 extern uint64_t total_times;
 extern el::Logger* mycpu_log;
-extern FILE* golden_trace;
+IFDEF(CONFIG_WAVE_ON, extern const char* arg_wave);
 #define RST_TIME 128
+// charge the host time since the last lap to a phase of the main loop
+#define PROF_LAP(phase) IFDEF(CONFIG_SIM_PROF, prof.lap(sim_prof::phase))
 
 inline static void sim_ending(int nemu_end_state){/*{{{*/
     switch (nemu_end_state) {
@@ -60,6 +81,7 @@ static bool sim_end_statistics(){/*{{{*/
     return res;
 }/*}}}*/
 
+#ifndef CONFIG_REF_THREAD
 static void check_cpu_state(diff_state* mycpu){/*{{{*/
     bool res = nemu->ref_checkregs(mycpu);
     if (!res){
@@ -69,6 +91,85 @@ static void check_cpu_state(diff_state* mycpu){/*{{{*/
     }
 }/*}}}*/
 
+#if defined(CONFIG_COMMIT_DIFF) && !defined(CONFIG_SIG_DIFF)
+static bool check_commit(const debug_info_t* commit, diff_state* mycpu){/*{{{*/
+    bool res = nemu->ref_check_commit(commit);
+    if (!res){
+        __ASSERT_SIM__(0, "MyCPU execution\t{} error !!!",
+                nemu->isa_disasm_inst());
+        nemu->ref_log_commit_error(commit);
+        dpi_api_get_state(mycpu);
+        nemu->ref_log_error(mycpu);
+    }
+    return res;
+}/*}}}*/
+#endif
+
+#ifdef CONFIG_SIG_DIFF
+static commit_sig<CONFIG_SIG_WINDOW> sig;
+// compare the signatures of the commit window, replay it on a mismatch
+static bool check_sig(diff_state* mycpu){/*{{{*/
+    bool res = sig.agree();
+    int seq = res ? -1 : sig.replay();
+    if (seq >= 0){
+        extern void print_reg_diff(word_t ref, word_t my_ans, const char* name);
+        const debug_info_t& dut = sig.dut_at(seq);
+        const debug_info_t& ref = sig.ref_at(seq);
+        __ASSERT_SIM__(0, "MyCPU execution\t{} error, {} commits before the signature check !!!",
+                llvm_disassemble(ref.pc, sig.inst_at(seq)), sig.size() - seq - 1);
+        print_reg_diff(ref.pc, dut.pc, "commit-pc");
+        print_reg_diff(ref.wnum, dut.wnum, "commit-wnum");
+        print_reg_diff(ref.wdata, dut.wdata, "commit-wdata");
+        dpi_api_get_state(mycpu);
+        nemu->ref_log_error(mycpu);
+    }
+    sig.reset();
+    return seq < 0;
+}/*}}}*/
+#endif
+#endif
+
+#ifdef CONFIG_REF_TRACE
+// nemu replaces the reference trace, memory reads are compared again
+static bool ref_take_over(ref_trace& trace, axi_paddr* axi, dual_soc& soc, uint64_t cycle){/*{{{*/
+    if (!trace.take_over(cycle)) return false;
+    IFDEF(CONFIG_MEM_DIFF, axi->set_diff_mem(soc.get_ref_soc()));
+    return true;
+}/*}}}*/
+#endif
+
+#ifdef CONFIG_REF_THREAD
+static void ref_finish(ref_thread& ref, dual_soc& soc){/*{{{*/
+    switch (ref.finish()) {
+        case ref_thread::REF_MISMATCH: {
+            diff_state mycpu = ref.failed_record().state;
+            __ASSERT_SIM__(0, "MyCPU execution\t{} error at tick {} !!!",
+                    nemu->isa_disasm_inst(), ref.failed_record().ticks);
+#ifdef CONFIG_COMMIT_DIFF
+            if (ref.failed_commit() >= 0)
+                nemu->ref_log_commit_error(&ref.failed_record().commit[ref.failed_commit()]);
+            if (ref.failed_record().full_diff)
+#endif
+            nemu->ref_log_error(&mycpu);
+            break;
+        }
+#ifdef CONFIG_HAS_UART
+        case ref_thread::REF_UART_MISMATCH:
+            __ASSERT_SIM__(0, "uart differs from ref at tick {}: ext_int {} ref {}, regs {:#018x} ref {:#018x}",
+                    ref.failed_record().ticks, ref.failed_record().ext_int, soc.ref_ext_int(),
+                    ref.failed_record().uart, soc.uart_regs(dual_soc::REF));
+            break;
+#endif
+        case ref_thread::REF_QUIT:
+            if (sim_status == SIM_RUN) sim_ending(nemu_state.state);
+            break;
+        default:
+            break;
+    }
+    __ASSERT_SIM__(soc.check_output(), "mycpu output is different from nemu");
+}/*}}}*/
+#endif
+
 bool mainloop(
         Vmycpu_top* top,
         axi_paddr* axi,
@@ -76,92 +177,304 @@ bool mainloop(
         dual_soc& soc
         ){/*{{{*/
 
-    diff_state mycpu;
+    IFNDEF(CONFIG_REF_THREAD, diff_state mycpu);
+    IFDEF(CONFIG_COMMIT_DIFF, uint64_t commit_cycles = 0);
     sim_status = SIM_RUN;
+    // a run restored from a checkpoint dumps waves from there and takes no checkpoint
+    IFDEF(CONFIG_SIM_CKPT, extern int arg_restore);
+    IFDEF(CONFIG_SIM_CKPT, bool restored = arg_restore >= 0);
 
-    IFDEF(CONFIG_WAVE_ON,Verilated::traceEverOn(true));
-    IFDEF(CONFIG_WAVE_ON,wave_file_t tfp);
-    IFDEF(CONFIG_WAVE_ON,top->trace(&tfp,0));
-    IFDEF(CONFIG_WAVE_ON,tfp.open((CONFIG_WAVE_DIR"/"+wave_name + "." + CONFIG_WAVE_EXT).c_str()));
     IFDEF(CONFIG_CP0_DIFF, cp0_checker mycpu_cp0_checker);
+#ifdef CONFIG_REF_TRACE
+    extern const char* arg_record;
+    extern const char* arg_replay;
+    ref_trace trace(soc);
+    if (*arg_replay) trace.open(std::string(arg_replay) + "/" + wave_name + ".ref");
+    if (!trace.replaying() && *arg_record) trace.create(std::string(arg_record) + "/" + wave_name + ".ref");
+    IFDEF(CONFIG_MEM_DIFF, axi->set_diff_mem(trace.replaying() ? nullptr : soc.get_ref_soc()));
+#endif
 
     ticks = 0;
     top->aclk = 0;
     top->aresetn = 0;
     IFDEF(CONFIG_COMMIT_WAIT, uint64_t last_commit = ticks);
-    IFDEF(CONFIG_PERF_ANALYSES, perf_timer(AddrIntv(0x1fc00000,bit_mask(22))));
+    IFDEF(CONFIG_PERF_ANALYSES, inst_timer perf_timer(wave_name));
+#ifdef CONFIG_SIM_CKPT
+    sim_ckpt ckpt(top, axi, soc, wave_name);
+    ckpt.keep(ticks);
+    IFDEF(CONFIG_COMMIT_DIFF, ckpt.keep(commit_cycles));
+    IFDEF(CONFIG_COMMIT_WAIT, ckpt.keep(last_commit));
+    if (restored && !ckpt.restore(arg_restore)) {
+        sim_status = SIM_ABORT;
+        return sim_end_statistics();
+    }
+#endif
+#ifdef CONFIG_WAVE_ON
+    wave_ctl wave(top, wave_name, arg_wave, MUXDEF(CONFIG_SIM_CKPT, restored, true));
+    if (!wave.ok()) {
+        sim_status = SIM_ABORT;
+        return sim_end_statistics();
+    }
+    soc.set_output_watch(wave.output_watch());
+#endif
 
-    while (ticks < (RST_TIME & ~0x1)) {
+    while (IFDEF(CONFIG_SIM_CKPT, !restored &&) ticks < (RST_TIME & ~0x1)) {
         ++ticks;
         axi->reset();
         nemu->reset();
         top->aclk = !top->aclk;
         top->eval();
-        IFDEF(CONFIG_WAVE_ON,tfp.dump(ticks));
+        IFDEF(CONFIG_WAVE_ON, wave.dump(ticks));
     }
 
     top->aresetn = 1;
+    IFDEF(CONFIG_SIM_PROF, sim_prof prof);
+#ifdef CONFIG_REF_THREAD
+    uint64_t cycle = 0;
+    std::unique_ptr<ref_thread> ref(new ref_thread(soc));
+    ref->start();
+#endif
+    IFDEF(CONFIG_REF_TRACE, uint64_t cycle = 0);
 
     while (!Verilated::gotFinish()) {
-        /* if need count perf_timer TIMED_SCOPE(one_clk,"one_clk"); */
         /* posedge edge comming {{{*/
+        PROF_LAP(PH_OTHER);
         ++ticks;
         top->aclk = !top->aclk;
 
         /* update SoC and nemu clock */
+#ifdef CONFIG_REF_THREAD
+        soc.tick_dut();
+        cycle++;
+#elif defined(CONFIG_REF_TRACE)
+        cycle++;
+        if (trace.replaying()) {
+            soc.tick_dut_alone(trace.dut_output());
+            trace.check_output(false);
+        }
+        else {
+            soc.tick();
+            nemu->ref_tick_and_int(0);
+        }
+#else
         soc.tick();
         nemu->ref_tick_and_int(0);
+#endif
+        PROF_LAP(PH_SOC);
 
         /* update mycpu */
         axi->calculate_output();
+        PROF_LAP(PH_AXI);
         top->eval();
+        PROF_LAP(PH_EVAL);
         axi->update_output();
+        PROF_LAP(PH_AXI);
 
         /* record waveform */
-        IFDEF(CONFIG_WAVE_ON,tfp.dump(ticks));
+        IFDEF(CONFIG_WAVE_ON, wave.dump(ticks));
+        PROF_LAP(PH_WAVE);
 
         /* check mainloop condition */
         if (sim_status!=SIM_RUN) break;
+        IFDEF(CONFIG_REF_THREAD, if (ref->stopped()) break);
 
         /* record coprocessor 0 change for later difftest */
         IFDEF(CONFIG_CP0_DIFF, mycpu_cp0_checker.check_change());
 
         /* get mycpu instructions commit status */
         uint8_t commit_num = dpi_retire();
+        IFDEF(CONFIG_COMMIT_DIFF, __ASSERT_SIM__(commit_num <= CONFIG_COMMIT_WIDTH, \
+                    "{} instructions retired, COMMIT_WIDTH is {}", commit_num, CONFIG_COMMIT_WIDTH));
+        IFDEF(CONFIG_SIM_PROF, prof.cycle(commit_num));
 
         /* run nemu and check difference {{{*/
+#ifdef CONFIG_REF_THREAD
+        if (commit_num > 0) {
+            commit_record rec = {ticks, cycle, commit_num, dpi_interrupt_seq(), soc.dut_ext_int(),
+                MUXDEF(CONFIG_HAS_UART, soc.uart_regs(dual_soc::DUT), 0)};
+#ifdef CONFIG_COMMIT_DIFF
+            dpi_api_get_commits(rec.commit, commit_num);
+            rec.full_diff = ++commit_cycles % CONFIG_FULL_DIFF_PERIOD == 0;
+            if (rec.full_diff)
+#endif
+            dpi_api_get_state(&rec.state);
+#ifdef CONFIG_WAVE_ON
+            if (unlikely(wave.watch_pc()))
+                for (size_t i = 0; i < commit_num; i++)
+                    wave.retire(MUXDEF(CONFIG_COMMIT_DIFF, rec.commit[i].pc, dpi_retirePC()), ticks);
+#endif
+            ref->push(rec);
+            PROF_LAP(PH_CHECK);
+            IFDEF(CONFIG_COMMIT_WAIT, last_commit = ticks);
+        }
+#else
         if (commit_num > 0) {
             uint8_t mycpu_int = dpi_interrupt_seq();
+            IFDEF(CONFIG_COMMIT_DIFF, debug_info_t commit[CONFIG_COMMIT_WIDTH]);
+            IFDEF(CONFIG_COMMIT_DIFF, dpi_api_get_commits(commit, commit_num));
+#ifdef CONFIG_WAVE_ON
+            if (unlikely(wave.watch_pc()))
+                for (size_t i = 0; i < commit_num; i++)
+                    wave.retire(MUXDEF(CONFIG_COMMIT_DIFF, commit[i].pc, dpi_retirePC()), ticks);
+#endif
             for (size_t i = 0; i < commit_num; i++) {
-                // TIMED_SCOPE(nemu_once, "nemu_once");
-                if (!nemu->ref_exec_once(i+1 == mycpu_int)) {
-                    sim_ending(nemu_state.state);
+#ifdef CONFIG_REF_TRACE
+                if (trace.replaying()) {
+                    ref_trace::result_t res = trace.check(commit[i], i+1 == mycpu_int);
+                    if (res == ref_trace::TRACE_OK) continue;
+                    if (res == ref_trace::TRACE_END) {
+                        sim_ending(trace.end_state());
+                        goto negtive_edge;
+                    }
+                    if (!ref_take_over(trace, axi, soc, cycle)) goto negtive_edge;
+                }
+                trace.before_exec(cycle);
+#endif
+                PROF_LAP(PH_CHECK);
+                bool nemu_ok = nemu->ref_exec_once(i+1 == mycpu_int);
+                PROF_LAP(PH_NEMU);
+                if (!nemu_ok) {
+                    IFDEF(CONFIG_REF_TRACE, trace.record(cycle, i+1 == mycpu_int));
+                    // a wrong path in the window may be why nemu quit
+                    if (MUXDEF(CONFIG_SIG_DIFF, check_sig(&mycpu), true)) sim_ending(nemu_state.state);
                     goto negtive_edge;
                 }
                 Decode& inst = nemu->inst_state;
-                if (inst.skip) nemu->arch_state.gpr[inst.wnum] = dpi_regfile(inst.wnum);
+                if (inst.skip) nemu->arch_state.gpr[inst.wnum] = \
+                    MUXDEF(CONFIG_COMMIT_DIFF, commit[i].wdata, dpi_regfile(inst.wnum));
+                IFDEF(CONFIG_REF_TRACE, trace.record(cycle, i+1 == mycpu_int));
+#ifdef CONFIG_SIG_DIFF
+                debug_info_t ref = {inst.pc, 0xf, inst.wnum, nemu->arch_state.gpr[inst.wnum]};
+                if (sig.add(commit[i], ref, inst.inst) && !check_sig(&mycpu)) goto negtive_edge;
+#else
+                IFDEF(CONFIG_COMMIT_DIFF, if (!check_commit(&commit[i], &mycpu)) goto negtive_edge);
+#endif
                 IFDEF(CONFIG_CP0_DIFF, mycpu_cp0_checker.check_value(inst.pc, nemu->cp0));
                 IFDEF(CONFIG_PERF_ANALYSES, if (nemu->analysis) \
-                    perf_timer.add_inst(nemu->inst_state, ((consume_t)(ticks-last_commit))/commit_num, ticks));
+                    perf_timer.add_inst(nemu->inst_state, \
+                        nemu->mmu_check(inst.pc) == CPU_state::MMU_TRANSLATE ? nemu->cp0.entryhi.asid : 0, \
+                        ((consume_t)(ticks-last_commit))/commit_num, ticks));
             }
-            dpi_api_get_state(&mycpu);
-            check_cpu_state(&mycpu);
+            if (MUXDEF(CONFIG_COMMIT_DIFF, ++commit_cycles % CONFIG_FULL_DIFF_PERIOD == 0, true)) {
+                IFDEF(CONFIG_SIG_DIFF, if (!check_sig(&mycpu)) goto negtive_edge);
+                dpi_api_get_state(&mycpu);
+#ifdef CONFIG_REF_TRACE
+                if (trace.replaying() && !trace.check_regs(&mycpu) && !ref_take_over(trace, axi, soc, cycle))
+                    goto negtive_edge;
+                if (!trace.replaying())
+#endif
+                check_cpu_state(&mycpu);
+            }
+            PROF_LAP(PH_CHECK);
             IFDEF(CONFIG_COMMIT_WAIT, last_commit = ticks);
-        }/*}}}*/
+        }
+#endif
+        /*}}}*/
 
         /*}}}*/
         /* negtive edge comming {{{*/
+#ifndef CONFIG_REF_THREAD
 negtive_edge: 
+#endif
+        PROF_LAP(PH_CHECK);
+        ++ticks;
+        top->aclk = !top->aclk;
+        top->eval();
+        PROF_LAP(PH_EVAL);
+        IFDEF(CONFIG_WAVE_ON, wave.dump(ticks));
+        PROF_LAP(PH_WAVE);
+        IFDEF(CONFIG_COMMIT_WAIT, __ASSERT_SIM__(ticks-last_commit<CONFIG_COMMIT_TIME_LIMIT, \
+                    "{} ticks not commit inst", \
+                    CONFIG_COMMIT_TIME_LIMIT));
+        IFDEF(CONFIG_SIM_CKPT, if (!restored && sim_status == SIM_RUN && ckpt.due(ticks)) ckpt.save(ticks));
+        /*}}}*/
+    }
+
+    IFDEF(CONFIG_REF_THREAD, ref_finish(*ref, soc));
+    IFDEF(CONFIG_SIG_DIFF, check_sig(&mycpu));
+    IFDEF(CONFIG_REF_TRACE, trace.finish());
+    IFDEF(CONFIG_WAVE_ON, wave.finish(sim_status != SIM_END));
+    IFDEF(CONFIG_WAVE_ON, soc.set_output_watch(nullptr));
+    IFDEF(CONFIG_PERF_ANALYSES, perf_timer.save_date());
+    IFDEF(CONFIG_SIM_PROF, prof.finish(wave_name + ".prof.json"));
+    return sim_end_statistics();
+}/*}}}*/
+
+#ifdef CONFIG_GOLDEN_TRACE
+// the pc the NSCSCC testbench ends the function test at
+#define GOLDEN_END_PC 0xbfc00100
+bool golden_mainloop(
+        Vmycpu_top* top,
+        axi_paddr* axi,
+        std::string wave_name,
+        dual_soc& soc,
+        golden_trace& golden
+        ){/*{{{*/
+    sim_status = SIM_RUN;
+
+    ticks = 0;
+    top->aclk = 0;
+    top->aresetn = 0;
+    IFDEF(CONFIG_COMMIT_WAIT, uint64_t last_commit = ticks);
+    golden.rewind();
+#ifdef CONFIG_WAVE_ON
+    wave_ctl wave(top, wave_name, arg_wave, true);
+    if (!wave.ok()) {
+        sim_status = SIM_ABORT;
+        return sim_end_statistics();
+    }
+    soc.set_output_watch(wave.output_watch());
+#endif
+
+    while (ticks < (RST_TIME & ~0x1)) {
+        ++ticks;
+        axi->reset();
+        top->aclk = !top->aclk;
+        top->eval();
+        IFDEF(CONFIG_WAVE_ON, wave.dump(ticks));
+    }
+
+    top->aresetn = 1;
+    while (!Verilated::gotFinish()) {
+        /* posedge edge comming {{{*/
         ++ticks;
         top->aclk = !top->aclk;
+        soc.tick_dut_alone();
+        axi->calculate_output();
         top->eval();
-        IFDEF(CONFIG_WAVE_ON,tfp.dump(ticks));
+        axi->update_output();
+        IFDEF(CONFIG_WAVE_ON, wave.dump(ticks));
+        if (sim_status!=SIM_RUN) break;
+
+        uint8_t commit_num = dpi_retire();
+        __ASSERT_SIM__(commit_num <= CONFIG_COMMIT_WIDTH, \
+                "{} instructions retired, COMMIT_WIDTH is {}", commit_num, CONFIG_COMMIT_WIDTH);
+        if (commit_num > 0) {
+            debug_info_t commit[CONFIG_COMMIT_WIDTH];
+            dpi_api_get_commits(commit, std::min<uint8_t>(commit_num, CONFIG_COMMIT_WIDTH));
+            for (size_t i = 0; i < commit_num && sim_status == SIM_RUN; i++) {
+                log_pc = commit[i].pc;
+                IFDEF(CONFIG_WAVE_ON, if (unlikely(wave.watch_pc())) wave.retire(commit[i].pc, ticks));
+                if (commit[i].pc == GOLDEN_END_PC) sim_status = SIM_END;
+                else if (commit[i].wen && commit[i].wnum && soc.dut_open_trace()) golden.check(commit[i]);
+            }
+            IFDEF(CONFIG_COMMIT_WAIT, last_commit = ticks);
+            if (sim_status!=SIM_RUN) break;
+        }
+        /*}}}*/
+        /* negtive edge comming {{{*/
+        ++ticks;
+        top->aclk = !top->aclk;
+        top->eval();
+        IFDEF(CONFIG_WAVE_ON, wave.dump(ticks));
         IFDEF(CONFIG_COMMIT_WAIT, __ASSERT_SIM__(ticks-last_commit<CONFIG_COMMIT_TIME_LIMIT, \
                     "{} ticks not commit inst", \
                     CONFIG_COMMIT_TIME_LIMIT));/*}}}*/
     }
 
-    IFDEF(CONFIG_WAVE_ON,tfp.close());
-    IFDEF(CONFIG_PERF_ANALYSES, perf_timer.save_date(wave_name+".bin"));
+    IFDEF(CONFIG_WAVE_ON, wave.finish(sim_status != SIM_END));
+    IFDEF(CONFIG_WAVE_ON, soc.set_output_watch(nullptr));
+    mycpu_log->info("%v of %v golden trace records checked", golden.checked(), golden.size());
     return sim_end_statistics();
 }/*}}}*/
+#endif
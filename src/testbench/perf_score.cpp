@@ -0,0 +1,123 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_TEST_PERF
+#include "testbench/perf_score.hpp"
+#include "easylogging++.h"
+#include <fmt/format.h>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+extern el::Logger* mycpu_log;
+
+// confreg timer count of gs132, the reference CPU of NSCSCC, by program
+static const struct {
+    const char* name;
+    uint32_t count;
+} perf_ref[] = {
+    {"bitcount"    , 0x13cf7fa },
+    {"bubble_sort" , 0x7bdd47e },
+    {"coremark"    , 0x10ce6772},
+    {"crc32"       , 0xaa1aa5c },
+    {"dhrystone"   , 0x1fc00d8 },
+    {"quick_sort"  , 0x719615a },
+    {"select_sort" , 0x6e0009a },
+    {"sha"         , 0x74b8b20 },
+    {"stream_copy" , 0x853b00  },
+    {"stringsearch", 0x50a1bcc },
+};
+#define NR_PERF_REF (sizeof(perf_ref) / sizeof(perf_ref[0]))
+
+perf_score::perf_score(const std::vector<perf_result>& results){/*{{{*/
+    for (auto& res: results) {
+        double ratio = 0;
+        if (res.pass && res.num && res.program >= 1 && res.program <= NR_PERF_REF)
+            ratio = (double)perf_ref[res.program - 1].count / res.num;
+        rows.push_back({res, ratio, 0});
+    }
+}/*}}}*/
+
+const char* perf_score::name(uint32_t program){/*{{{*/
+    return program >= 1 && program <= NR_PERF_REF ? perf_ref[program - 1].name : "unknown";
+}/*}}}*/
+
+double perf_score::geo_mean(bool common, bool base) const{/*{{{*/
+    double sum = 0;
+    int n = 0;
+    for (auto& it: rows) {
+        if (!it.ratio || ((common || base) && !it.base)) continue;
+        sum += std::log(base ? (double)perf_ref[it.res.program - 1].count / it.base : it.ratio);
+        n++;
+    }
+    return n ? std::exp(sum / n) : 0;
+}/*}}}*/
+
+bool perf_score::load_baseline(const std::string& filename){/*{{{*/
+    FILE* fp = fopen(filename.c_str(), "r");
+    if (!fp) {
+        mycpu_log->error("perf_score fail to read baseline %v", filename);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        uint32_t program, count;
+        int pass;
+        // program,name,pass,count,...
+        if (sscanf(line, "%u,%*[^,],%d,%u", &program, &pass, &count) != 3 || !pass) continue;
+        for (auto& it: rows) {
+            if (it.res.program == program) it.base = count;
+        }
+    }
+    fclose(fp);
+    baseline = filename;
+    return true;
+}/*}}}*/
+
+void perf_score::report(int jobs, double seconds) const{/*{{{*/
+    int pass = 0;
+    mycpu_log->info("[perf] program name         result      count       cycles    ratio   baseline     diff  seconds");
+    for (auto& it: rows) {
+        const perf_result& res = it.res;
+        pass += res.pass;
+        std::string diff = it.base && res.pass ? fmt::format("{:+.2f}%", 100.0 * ((double)res.num - it.base) / it.base) : "-";
+        mycpu_log->info(fmt::format("[perf] {:>7} {:<12} {:<6} {:>10x} {:>12} {:>8.3f} {:>10x} {:>8} {:>8.1f}",
+                    res.program, name(res.program), res.pass ? "pass" : "fail", res.num, res.cycles,
+                    it.ratio, it.base, diff, res.seconds));
+    }
+    mycpu_log->info(fmt::format("[perf] {}/{} pass, {} jobs, {:.1f} s", pass, rows.size(), jobs, seconds));
+    mycpu_log->info(fmt::format("[perf] score {:.3f}{}", geo_mean(false, false),
+                pass == (int)NR_PERF_REF ? "" : fmt::format(" of {} programs, not comparable with NSCSCC", pass)));
+    if (!baseline.empty())
+        mycpu_log->info(fmt::format("[perf] score {:.3f} of baseline {:.3f} on the programs both pass",
+                    geo_mean(true, false), geo_mean(true, true)));
+}/*}}}*/
+
+bool perf_score::save(const std::string& prefix) const{/*{{{*/
+    fmt::memory_buffer json, csv;
+    fmt::format_to(std::back_inserter(json), "{{\"score\": {:.6f}, \"programs\": [", geo_mean(false, false));
+    fmt::format_to(std::back_inserter(csv), "program,name,pass,count,cycles,ratio,baseline\n");
+    for (size_t i = 0; i < rows.size(); i++) {
+        const row& it = rows[i];
+        fmt::format_to(std::back_inserter(json), "{}\n  {{\"program\": {}, \"name\": \"{}\", \"pass\": {}, \"count\": {}, "
+                "\"cycles\": {}, \"ratio\": {:.6f}, \"baseline\": {}}}", i ? "," : "", it.res.program,
+                name(it.res.program), it.res.pass, it.res.num, it.res.cycles, it.ratio, it.base);
+        fmt::format_to(std::back_inserter(csv), "{},{},{:d},{},{},{:.6f},{}\n", it.res.program,
+                name(it.res.program), it.res.pass, it.res.num, it.res.cycles, it.ratio, it.base);
+    }
+    fmt::format_to(std::back_inserter(json), "\n]");
+    if (!baseline.empty())
+        fmt::format_to(std::back_inserter(json), ", \"common_score\": {:.6f}, \"baseline_score\": {:.6f}",
+                geo_mean(true, false), geo_mean(true, true));
+    fmt::format_to(std::back_inserter(json), "}}\n");
+
+    bool res = true;
+    for (auto file: {std::make_pair(prefix + ".json", &json), std::make_pair(prefix + ".csv", &csv)}) {
+        FILE* fp = fopen(file.first.c_str(), "w");
+        if (!fp || fwrite(file.second->data(), 1, file.second->size(), fp) != file.second->size()) {
+            mycpu_log->error("perf_score fail to write %v", file.first);
+            res = false;
+        }
+        if (fp) fclose(fp);
+    }
+    return res;
+}/*}}}*/
+#endif
@@ -0,0 +1,70 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_PERF_STREAM
+#include "testbench/perf_stream.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+
+static bool write_all(int fd, const uint8_t* data, size_t len){/*{{{*/
+    while (len) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}/*}}}*/
+
+bool perf_stream::open(const std::string& filename, const void* head, size_t len){/*{{{*/
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) return false;
+    if (!write_all(fd, (const uint8_t*)head, len)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    for (auto& b: buf) b.reset(new uint8_t[buf_size]);
+    writer = std::thread(&perf_stream::run, this);
+    return true;
+}/*}}}*/
+
+void perf_stream::run(){/*{{{*/
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        cv.wait(guard, [this]{ return pending >= 0 || quit; });
+        if (pending < 0) return;
+        int idx = pending;
+        size_t len = pending_len;
+        guard.unlock();
+        bool ok = write_all(fd, buf[idx].get(), len);
+        guard.lock();
+        failed |= !ok;
+        pending = -1;
+        cv.notify_all();
+    }
+}/*}}}*/
+
+void perf_stream::handoff(){/*{{{*/
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [this]{ return pending < 0; });
+    pending = cur;
+    pending_len = used;
+    cv.notify_all();
+    cur ^= 1;
+    used = 0;
+}/*}}}*/
+
+bool perf_stream::close(){/*{{{*/
+    if (fd < 0) return !failed;
+    if (used) handoff();
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        cv.wait(guard, [this]{ return pending < 0; });
+        quit = true;
+        cv.notify_all();
+    }
+    writer.join();
+    ::close(fd);
+    fd = -1;
+    return !failed;
+}/*}}}*/
+#endif
@@ -0,0 +1,62 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_REF_THREAD
+#include "testbench/ref_thread.hpp"
+#include "nemu/isa.hpp"
+
+ref_thread::result_t ref_thread::check(const commit_record& rec){/*{{{*/
+    for (; cycle < rec.cycle; cycle++) {
+        soc.tick_ref();
+        nemu->ref_tick_and_int(0);
+    }
+#ifdef CONFIG_HAS_UART
+    if (rec.ext_int != soc.ref_ext_int() || rec.uart != soc.uart_regs(dual_soc::REF)) return REF_UART_MISMATCH;
+#endif
+    for (size_t i = 0; i < rec.commit_num; i++) {
+        if (!nemu->ref_exec_once(i+1 == rec.int_seq)) return REF_QUIT;
+        Decode& inst = nemu->inst_state;
+        if (inst.skip) nemu->arch_state.gpr[inst.wnum] =
+            MUXDEF(CONFIG_COMMIT_DIFF, rec.commit[i].wdata, rec.state.gpr[inst.wnum]);
+#ifdef CONFIG_COMMIT_DIFF
+        if (!nemu->ref_check_commit(&rec.commit[i])) {
+            failed_seq = i;
+            return REF_MISMATCH;
+        }
+#endif
+    }
+    IFDEF(CONFIG_COMMIT_DIFF, if (!rec.full_diff) return REF_RUNNING);
+    diff_state mycpu = rec.state;
+    return nemu->ref_checkregs(&mycpu) ? REF_RUNNING : REF_MISMATCH;
+}/*}}}*/
+
+void ref_thread::run(){/*{{{*/
+    while (true) {
+        const commit_record* rec = ring.front();
+        if (rec == nullptr) {
+            std::this_thread::yield();
+            continue;
+        }
+        result_t res = rec->commit_num ? check(*rec) : REF_DONE;
+        if (res != REF_RUNNING) {
+            failed = *rec;
+            ring.pop();
+            result.store(res, std::memory_order_release);
+            return;
+        }
+        ring.pop();
+    }
+}/*}}}*/
+
+void ref_thread::push(const commit_record& rec){/*{{{*/
+    while (!ring.try_push(rec)) {
+        if (stopped()) return;
+        std::this_thread::yield();
+    }
+}/*}}}*/
+
+ref_thread::result_t ref_thread::finish(){/*{{{*/
+    commit_record end = {};
+    push(end);
+    worker.join();
+    return result.load(std::memory_order_acquire);
+}/*}}}*/
+#endif
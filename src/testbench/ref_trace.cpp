@@ -0,0 +1,390 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_REF_TRACE
+#include "testbench/ref_trace.hpp"
+#include "testbench/sim_state.hpp"
+#include "nemu/isa.hpp"
+#include "easylogging++.h"
+#include "path.hh"
+#include "utils.hpp"
+#include <fmt/core.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+extern el::Logger* mycpu_log;
+extern uint32_t log_pc;
+static const char head_magic[8] = {'H', 'I', 'T', 'D', 'R', 'E', 'F', 'T'};
+static const char tail_magic[8] = {'H', 'I', 'T', 'D', 'R', 'E', 'N', 'D'};
+#define REF_TRACE_VERSION 1
+#define SNAP_PAGE 4096
+
+static_assert(sizeof(ref_trace::rec) == 24, "ref_trace::rec is packed by hand");
+
+// crc32 of the test binary, a trace of another program is refused
+static uint32_t test_bin_crc(){/*{{{*/
+    std::ifstream file(__TEST_BIN__, std::ios::in | std::ios::binary);
+    uLong crc = crc32(0, Z_NULL, 0);
+    char buf[1 << 16];
+    while (file.read(buf, sizeof(buf)) || file.gcount())
+        crc = crc32(crc, (const Bytef*)buf, file.gcount());
+    return crc;
+}/*}}}*/
+
+ref_trace::ref_trace(dual_soc& soc_input):/*{{{*/
+    soc(soc_input), seq(0), fp(nullptr), last_cycle(0), exl(false),
+    map(nullptr), map_len(0), tail(nullptr), chunk_off(nullptr), chunk(0), pos(0), replay(false),
+    last_pc(0), hi(0), lo(0), hilo(false), out_checked(0) {
+    memset(gpr, 0, sizeof(gpr));
+}/*}}}*/
+
+ref_trace::~ref_trace(){/*{{{*/
+    if (fp) {
+        fclose(fp);
+        soc.set_output_echo(nullptr);
+    }
+    if (map) munmap(map, map_len);
+}/*}}}*/
+
+/* recording {{{*/
+bool ref_trace::create(const std::string& filename){/*{{{*/
+    fp = fopen(filename.c_str(), "w");
+    if (!fp) {
+        mycpu_log->error("reference trace fail to create %v", filename);
+        return false;
+    }
+    name = filename;
+    file_head h = {{}, REF_TRACE_VERSION, sizeof(rec), test_bin_crc(), 0};
+    memcpy(h.magic, head_magic, sizeof(head_magic));
+    fwrite(&h, sizeof(h), 1, fp);
+    // the first checkpoint holds every non-zero page
+    for (auto& r: soc.get_ref_soc()->mem_regions()) {
+        size_t size = r.pmem->get_mem_size();
+        shadow.emplace_back(new uint8_t[size]);
+        memset(shadow.back().get(), 0, size);
+    }
+    soc.set_output_echo(&ref_out);
+    mycpu_log->info("record the commits of nemu to %v", filename);
+    return true;
+}/*}}}*/
+
+void ref_trace::checkpoint(uint64_t cycle){/*{{{*/
+    cur = {seq, cycle, 0, 0, 0, 0, 0, 0};
+    state.clear();
+    auto regions = soc.get_ref_soc()->mem_regions();
+    state.put<uint32_t>(regions.size());
+    for (size_t i = 0; i < regions.size(); i++) {
+        const uint8_t* mem = regions[i].pmem->get_mem_ptr();
+        uint8_t* old = shadow[i].get();
+        uint32_t nr_page = regions[i].pmem->get_mem_size() / SNAP_PAGE;
+        std::vector<uint32_t> changed;
+        for (uint32_t p = 0; p < nr_page; p++) {
+            if (memcmp(mem + p * SNAP_PAGE, old + p * SNAP_PAGE, SNAP_PAGE) == 0) continue;
+            memcpy(old + p * SNAP_PAGE, mem + p * SNAP_PAGE, SNAP_PAGE);
+            changed.push_back(p);
+        }
+        state.put(nr_page);
+        state.put<uint32_t>(changed.size());
+        for (uint32_t p: changed) {
+            state.put(p);
+            state.put_bytes(mem + p * SNAP_PAGE, SNAP_PAGE);
+        }
+    }
+    nemu->save_state(state);
+    soc.get_ref_soc()->save_state(state);
+}/*}}}*/
+
+// zlib of one part, appended to fp
+static bool deflate_part(FILE* fp, const void* src, size_t len, uint32_t& zlen){/*{{{*/
+    uLongf dst_len = compressBound(len);
+    std::unique_ptr<Bytef[]> dst(new Bytef[dst_len]);
+    if (compress2(dst.get(), &dst_len, (const Bytef*)src, len, Z_BEST_SPEED) != Z_OK) return false;
+    zlen = dst_len;
+    return fwrite(dst.get(), 1, dst_len, fp) == dst_len;
+}/*}}}*/
+
+bool ref_trace::write_chunk(){/*{{{*/
+    std::string data((const char*)recs.data(), recs.size() * sizeof(rec));
+    data += ref_out;
+    cur.nr_rec = recs.size();
+    cur.out_len = ref_out.size();
+    cur.state_len = state.size();
+    cur.data_len = data.size();
+    off_t head_off = ftello(fp);
+    bool res = fwrite(&cur, sizeof(cur), 1, fp) == 1 &&
+        deflate_part(fp, state.data().data(), state.size(), cur.state_zlen) &&
+        deflate_part(fp, data.data(), data.size(), cur.data_zlen);
+    // the compressed sizes are known now
+    off_t end = ftello(fp);
+    res = res && fseeko(fp, head_off, SEEK_SET) == 0 && fwrite(&cur, sizeof(cur), 1, fp) == 1 &&
+        fseeko(fp, end, SEEK_SET) == 0;
+    index.push_back(head_off);
+    recs.clear();
+    ref_out.clear();
+    state.clear();
+    if (!res) {
+        mycpu_log->error("reference trace fail to write %v, recording stops", name);
+        fclose(fp);
+        fp = nullptr;
+        soc.set_output_echo(nullptr);
+    }
+    return res;
+}/*}}}*/
+
+void ref_trace::before_exec(uint64_t cycle){/*{{{*/
+    if (!fp) return;
+    if (recs.size() == CONFIG_REF_TRACE_CHUNK && !write_chunk()) return;
+    if (recs.empty()) checkpoint(cycle);
+    exl = nemu->cp0.status.exl;
+}/*}}}*/
+
+void ref_trace::record(uint64_t cycle, bool mycpu_int){/*{{{*/
+    if (!fp) return;
+    Decode& inst = nemu->inst_state;
+    rec r = {inst.pc, nemu->arch_state.gpr[inst.wnum], nemu->arch_state.hi, nemu->arch_state.lo,
+        (uint32_t)(cycle - last_cycle), inst.wnum, 0, 0};
+    if (mycpu_int) r.flag |= REC_INT;
+    if (inst.skip) r.flag |= REC_SKIP;
+    if (!exl && nemu->cp0.status.exl) r.flag |= REC_EXC;
+    if (nemu->hilo_valid) r.flag |= REC_HILO;
+    if (nemu_state.state == NEMU_END) r.flag |= REC_END;
+    if (nemu_state.state == NEMU_ABORT) r.flag |= REC_ABORT;
+    recs.push_back(r);
+    last_cycle = cycle;
+    seq++;
+}/*}}}*/
+/*}}}*/
+
+/* replaying {{{*/
+bool ref_trace::open(const std::string& filename){/*{{{*/
+    name = filename;
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        mycpu_log->error("reference trace %v not exist, nemu runs", filename);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    map_len = st.st_size;
+    map = map_len ? mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) map = nullptr;
+    const file_head* h = (const file_head*)map;
+    tail = map && map_len >= sizeof(file_head) + sizeof(file_tail) ?
+        (const file_tail*)((const uint8_t*)map + map_len - sizeof(file_tail)) : nullptr;
+    const char* error = nullptr;
+    if (!tail || memcmp(h->magic, head_magic, sizeof(head_magic)) || h->version != REF_TRACE_VERSION ||
+            h->rec_size != sizeof(rec)) error = "is not a reference trace of this version";
+    else if (memcmp(tail->magic, tail_magic, sizeof(tail_magic)) ||
+            tail->index_offset + tail->nr_chunk * sizeof(uint64_t) + sizeof(file_tail) != map_len)
+        error = "is not complete";
+    else if (h->bin_crc != test_bin_crc()) error = "is recorded with another " __TEST_BIN__;
+    else if (tail->nr_chunk == 0) error = "has no commit";
+    if (error) {
+        mycpu_log->error("reference trace %v %v, nemu runs", filename, error);
+        return false;
+    }
+    chunk_off = (const uint64_t*)((const uint8_t*)map + tail->index_offset);
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    if (!load_chunk(0)) return false;
+    replay = true;
+    mycpu_log->info("check MyCPU with %v commits of %v", tail->nr_rec, filename);
+    return true;
+}/*}}}*/
+
+bool ref_trace::inflate_part(uint32_t c, const uint8_t* src, uint32_t zlen, uint32_t len, std::string& dst){/*{{{*/
+    dst.resize(len);
+    uLongf dst_len = len;
+    if (src + zlen > (const uint8_t*)map + map_len ||
+            uncompress((Bytef*)&dst[0], &dst_len, src, zlen) != Z_OK || dst_len != len) {
+        mycpu_log->error("reference trace %v is broken at chunk %v", name, c);
+        return false;
+    }
+    return true;
+}/*}}}*/
+
+bool ref_trace::load_chunk(uint32_t c){/*{{{*/
+    const chunk_head* head = (const chunk_head*)((const uint8_t*)map + chunk_off[c]);
+    const uint8_t* zdata = (const uint8_t*)(head + 1) + head->state_zlen;
+    std::string data;
+    if (!inflate_part(c, zdata, head->data_zlen, head->data_len, data)) return false;
+    chunk = c;
+    recs.resize(head->nr_rec);
+    memcpy(recs.data(), data.data(), head->nr_rec * sizeof(rec));
+    ref_out.append(data, head->nr_rec * sizeof(rec), head->out_len);
+    pos = 0;
+    skips.clear();
+    return true;
+}/*}}}*/
+
+ref_trace::result_t ref_trace::check(const debug_info_t& commit, bool mycpu_int){/*{{{*/
+    log_pc = commit.pc;
+    if (unlikely(pos == recs.size())) {
+        if (chunk + 1 == tail->nr_chunk || !load_chunk(chunk + 1)) return TRACE_MISS;
+    }
+    const rec& r = recs[pos];
+    if (unlikely(r.flag & (REC_END | REC_ABORT))) return TRACE_END;
+    // as ref_check_commit(), with the register file of the trace
+    uint8_t wnum = commit.wen ? commit.wnum : 0;
+    word_t mask = wen_mask(commit.wen);
+    word_t wdata = r.flag & REC_SKIP ? commit.wdata : r.wdata;
+    if (unlikely(commit.pc != r.pc || (bool)(r.flag & REC_INT) != mycpu_int ||
+                (r.wnum && r.wnum != wnum))) return TRACE_MISS;
+    if (wnum && ((wnum == r.wnum ? wdata : gpr[wnum]) & mask) != (commit.wdata & mask)) return TRACE_MISS;
+    if (r.wnum) gpr[r.wnum] = wdata;
+    if (unlikely(r.flag & REC_SKIP)) skips.push_back(std::make_pair(pos, wdata));
+    last_pc = r.pc;
+    hi = r.hi;
+    lo = r.lo;
+    hilo = r.flag & REC_HILO;
+    pos++;
+    seq++;
+    return TRACE_OK;
+}/*}}}*/
+
+bool ref_trace::check_regs(const diff_state* mycpu){/*{{{*/
+    bool ans = mycpu->pc == last_pc;
+    for (int i = 0; i < 32; i++) ans &= mycpu->gpr[i] == gpr[i];
+#ifdef CONFIG_HILO_DIFF
+    if (hilo) ans &= mycpu->hi == hi && mycpu->lo == lo;
+#endif
+    return ans;
+}/*}}}*/
+
+bool ref_trace::check_output(bool end){/*{{{*/
+    size_t n = std::min(dut_out.size(), ref_out.size());
+    for (; out_checked < n; out_checked++) {
+        if (dut_out[out_checked] == ref_out[out_checked]) continue;
+        __ASSERT_SIM__(0, "output '{:c}' not equal to the trace '{:c}' at char {}",
+                dut_out[out_checked], ref_out[out_checked], out_checked);
+        return false;
+    }
+    if (end && dut_out.size() != ref_out.size()) {
+        __ASSERT_SIM__(0, "output {} chars, the trace {} chars", dut_out.size(), ref_out.size());
+        return false;
+    }
+    return true;
+}/*}}}*/
+
+int ref_trace::end_state() const{/*{{{*/
+    return recs[pos].flag & REC_END ? NEMU_END : NEMU_ABORT;
+}/*}}}*/
+
+// memory, nemu and its SoC of the checkpoint of the current chunk
+bool ref_trace::restore(){/*{{{*/
+    auto regions = soc.get_ref_soc()->mem_regions();
+    // the newest copy of every page saved by chunks up to this one
+    std::vector<std::string> states(chunk + 1);
+    std::vector<std::vector<const uint8_t*>> pages(regions.size());
+    for (size_t i = 0; i < regions.size(); i++) pages[i].resize(regions[i].pmem->get_mem_size() / SNAP_PAGE);
+    snap_reader last(nullptr, 0);
+    for (uint32_t c = 0; c <= chunk; c++) {
+        const chunk_head* head = (const chunk_head*)((const uint8_t*)map + chunk_off[c]);
+        if (!inflate_part(c, (const uint8_t*)(head + 1), head->state_zlen, head->state_len, states[c])) return false;
+        snap_reader in(states[c].data(), states[c].size());
+        uint32_t nr_region = 0;
+        in.get(nr_region);
+        if (nr_region != regions.size()) {
+            mycpu_log->error("reference trace %v has %v memories, the SoC has %v", name, nr_region, regions.size());
+            return false;
+        }
+        for (auto& region: pages) {
+            uint32_t nr_page = 0, nr_changed = 0, p = 0;
+            in.get(nr_page);
+            in.get(nr_changed);
+            if (nr_page != region.size()) in.take(~0ul);
+            for (; in.ok() && nr_changed; nr_changed--) {
+                in.get(p);
+                const uint8_t* data = in.take(SNAP_PAGE);
+                if (p < region.size()) region[p] = data;
+            }
+        }
+        if (!in.ok()) {
+            mycpu_log->error("reference trace %v has a broken checkpoint at chunk %v", name, c);
+            return false;
+        }
+        last = in;
+    }
+    static const uint8_t zero[SNAP_PAGE] = {};
+    for (size_t i = 0; i < regions.size(); i++) {
+        const uint8_t* mem = regions[i].pmem->get_mem_ptr();
+        for (size_t p = 0; p < pages[i].size(); p++) {
+            const uint8_t* want = pages[i][p] ? pages[i][p] : zero;
+            if (memcmp(mem + p * SNAP_PAGE, want, SNAP_PAGE))
+                regions[i].pmem->restore(p * SNAP_PAGE, want, SNAP_PAGE);
+        }
+    }
+    if (!nemu->load_state(last) || !soc.get_ref_soc()->load_state(last)) {
+        mycpu_log->error("reference trace %v has a broken checkpoint at chunk %v", name, chunk);
+        return false;
+    }
+    return true;
+}/*}}}*/
+
+bool ref_trace::take_over(uint64_t cycle){/*{{{*/
+    auto start = std::chrono::steady_clock::now();
+    replay = false;
+    check_output(false);
+    if (!restore()) {
+        __ASSERT_SIM__(0, "nemu can not take the place of the reference trace");
+        return false;
+    }
+    // the commits of the chunk already checked, on the cycles they were recorded at
+    const chunk_head* head = (const chunk_head*)((const uint8_t*)map + chunk_off[chunk]);
+    uint64_t nemu_cycle = head->first_cycle;
+    size_t skip = 0;
+    for (uint32_t i = 0; i < pos; i++) {
+        const rec& r = recs[i];
+        uint64_t target = i ? nemu_cycle + r.cycle : nemu_cycle;
+        for (; nemu_cycle < target; nemu_cycle++) {
+            soc.tick_ref_alone();
+            nemu->ref_tick_and_int(0);
+        }
+        bool running = nemu->ref_exec_once(r.flag & REC_INT);
+        Decode& inst = nemu->inst_state;
+        // the value this DUT gave, not the recorded one
+        if (inst.skip && skip < skips.size()) nemu->arch_state.gpr[inst.wnum] = skips[skip++].second;
+        if (!running || inst.pc != r.pc || inst.wnum != r.wnum ||
+                (!(r.flag & REC_SKIP) && nemu->arch_state.gpr[r.wnum] != r.wdata)) {
+            __ASSERT_SIM__(0, "nemu leaves the reference trace at commit {}, pc " HEX_WORD " trace " HEX_WORD,
+                    seq - pos + i, inst.pc, r.pc);
+            return false;
+        }
+    }
+    // timers as if nemu had ticked with this DUT
+    int64_t shift = cycle - nemu_cycle;
+    nemu->ref_shift_ticks(shift);
+    soc.shift_ref_time(shift);
+    soc.drop_ref_output();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    mycpu_log->info(fmt::format("MyCPU leaves the reference trace at commit {} (chunk {}, {:+} cycles), "
+                "nemu takes over after {} commits in {:.1f} ms", seq, chunk, shift, pos, ms));
+    return true;
+}/*}}}*/
+/*}}}*/
+
+void ref_trace::finish(){/*{{{*/
+    if (fp) {
+        bool res = recs.empty() || write_chunk();
+        if (fp && res) {
+            file_tail t = {(uint64_t)ftello(fp), seq, (uint32_t)index.size(), 0, {}};
+            memcpy(t.magic, tail_magic, sizeof(tail_magic));
+            res = fwrite(index.data(), sizeof(uint64_t), index.size(), fp) == index.size() &&
+                fwrite(&t, sizeof(t), 1, fp) == 1;
+        }
+        if (fp) res &= fclose(fp) == 0;
+        fp = nullptr;
+        soc.set_output_echo(nullptr);
+        if (res) mycpu_log->info("%v commits recorded to %v", seq, name);
+        else mycpu_log->error("reference trace fail to write %v", name);
+    }
+    if (map) {
+        if (replay && sim_status == SIM_END) check_output(true);
+        if (replay) mycpu_log->info("%v commits checked with %v", seq, name);
+    }
+}/*}}}*/
+#endif
@@ -0,0 +1,124 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_SIM_CKPT
+#include "testbench/sim_ckpt.hpp"
+#include "nemu/isa.hpp"
+#include "easylogging++.h"
+#include "verilated_save.h"
+#include <fmt/core.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+extern el::Logger* mycpu_log;
+static const char ckpt_magic[8] = {'H', 'I', 'T', 'D', 'S', 'I', 'M', 'C'};
+#define SIM_CKPT_VERSION 1
+
+sim_ckpt::sim_ckpt(Vmycpu_top* top_input, axi_paddr* axi_input, dual_soc& soc_input, const std::string& wave_name):/*{{{*/
+    top(top_input), axi(axi_input), soc(soc_input),
+    base(CONFIG_SIM_CKPT_DIR "/" + wave_name + ".ckpt"), seq(0) {
+    mkdir(CONFIG_SIM_CKPT_DIR, 0755);
+}/*}}}*/
+
+std::string sim_ckpt::slot_name(uint32_t slot) const{/*{{{*/
+    return fmt::format("{}.{}", base, slot);
+}/*}}}*/
+
+bool sim_ckpt::save(uint64_t ticks){/*{{{*/
+    auto start = std::chrono::steady_clock::now();
+    snap_writer state;
+    nemu->save_state(state);
+    axi->save_state(state);
+    for (PaddrTop* ptop: {soc.get_dut_soc(), soc.get_ref_soc()}) {
+        ptop->save_state(state);
+        ptop->save_memory(state);
+    }
+    for (uint64_t* var: kept) state.put(*var);
+    uLongf zlen = compressBound(state.size());
+    std::unique_ptr<Bytef[]> zdata(new Bytef[zlen]);
+    if (compress2(zdata.get(), &zlen, (const Bytef*)state.data().data(), state.size(), Z_BEST_SPEED) != Z_OK) {
+        mycpu_log->error("checkpoint at tick %v fail to compress", ticks);
+        return false;
+    }
+
+    head h = {{}, SIM_CKPT_VERSION, (uint32_t)kept.size(), ticks, seq, (uint32_t)state.size(), (uint32_t)zlen};
+    memcpy(h.magic, ckpt_magic, sizeof(ckpt_magic));
+    std::string tmp = base + ".tmp";
+    std::string name = slot_name(seq % CONFIG_SIM_CKPT_NR);
+    {
+        VerilatedSave os;
+        os.open(tmp.c_str());
+        if (!os.isOpen()) {
+            mycpu_log->error("checkpoint fail to create %v", tmp);
+            return false;
+        }
+        os.write(&h, sizeof(h));
+        os.write(zdata.get(), zlen);
+        os << *top;
+        os.close();
+    }
+    if (rename(tmp.c_str(), name.c_str()) != 0) {
+        mycpu_log->error("checkpoint fail to write %v", name);
+        remove(tmp.c_str());
+        return false;
+    }
+    seq++;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    mycpu_log->info(fmt::format("checkpoint of tick {} saved to {}, {} KB in {:.1f} ms", ticks, name, zlen >> 10, ms));
+    return true;
+}/*}}}*/
+
+bool sim_ckpt::read_head(const std::string& filename, head& h){/*{{{*/
+    if (access(filename.c_str(), R_OK) != 0) return false;
+    VerilatedRestore os;
+    os.open(filename.c_str());
+    if (!os.isOpen()) return false;
+    os.read(&h, sizeof(h));
+    os.close();
+    return memcmp(h.magic, ckpt_magic, sizeof(ckpt_magic)) == 0 && h.version == SIM_CKPT_VERSION &&
+        h.nr_keep == kept.size();
+}/*}}}*/
+
+bool sim_ckpt::restore(uint32_t age){/*{{{*/
+    // slots from the newest
+    std::vector<std::pair<uint64_t, uint32_t>> slots;
+    for (uint32_t slot = 0; slot < CONFIG_SIM_CKPT_NR; slot++) {
+        head h;
+        if (read_head(slot_name(slot), h)) slots.push_back(std::make_pair(h.seq, slot));
+    }
+    std::sort(slots.rbegin(), slots.rend());
+    if (age >= slots.size()) {
+        mycpu_log->error("%v checkpoints of %v, no one is %v older than the newest", slots.size(), base, age);
+        return false;
+    }
+    std::string name = slot_name(slots[age].second);
+    VerilatedRestore os;
+    os.open(name.c_str());
+    head h;
+    os.read(&h, sizeof(h));
+    std::unique_ptr<Bytef[]> zdata(new Bytef[h.state_zlen]);
+    os.read(zdata.get(), h.state_zlen);
+    std::string state(h.state_len, '\0');
+    uLongf len = h.state_len;
+    if (uncompress((Bytef*)&state[0], &len, zdata.get(), h.state_zlen) != Z_OK || len != h.state_len) {
+        mycpu_log->error("checkpoint %v is broken", name);
+        return false;
+    }
+    snap_reader in(state.data(), state.size());
+    bool res = nemu->load_state(in) && axi->load_state(in);
+    for (PaddrTop* ptop: {soc.get_dut_soc(), soc.get_ref_soc()})
+        res = res && ptop->load_state(in) && ptop->load_memory(in);
+    for (uint64_t* var: kept) in.get(*var);
+    if (!res || !in.ok() || in.left()) {
+        mycpu_log->error("checkpoint %v does not match this testbench", name);
+        return false;
+    }
+    os >> *top;
+    os.close();
+    mycpu_log->info("restore %v of tick %v", name, h.ticks);
+    return true;
+}/*}}}*/
+#endif
@@ -0,0 +1,54 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_SIM_PROF
+#include "testbench/sim_prof.hpp"
+#include "easylogging++.h"
+#include <fmt/format.h>
+#include <cstdio>
+#include <iterator>
+
+extern el::Logger* mycpu_log;
+static const char* phase_name[] = {"eval", "axi", "soc", "nemu", "check", "wave", "other"};
+
+void sim_prof::start(){/*{{{*/
+    for (auto& a: acc) a = 0;
+    cycles = commits = 0;
+    report_cycles = report_commits = 0;
+    start_time = report_time = clock::now();
+    start_stamp = last = stamp();
+}/*}}}*/
+
+void sim_prof::report(){/*{{{*/
+    clock::time_point now = clock::now();
+    double sec = std::chrono::duration<double>(now - report_time).count();
+    if (sec < CONFIG_SIM_PROF_PERIOD) return;
+    mycpu_log->info(fmt::format("[prof] {} cycles, {:.1f} kHz, {:.0f} commits/s",
+                cycles, (cycles - report_cycles) / sec / 1e3, (commits - report_commits) / sec));
+    report_cycles = cycles;
+    report_commits = commits;
+    report_time = now;
+}/*}}}*/
+
+void sim_prof::finish(const std::string& filename){/*{{{*/
+    lap(PH_OTHER);
+    double sec = std::chrono::duration<double>(clock::now() - start_time).count();
+    uint64_t total = last - start_stamp;
+    double sec_per_stamp = total ? sec / total : 0;
+    mycpu_log->info(fmt::format("[prof] {} cycles, {} commits in {:.2f} s: {:.1f} kHz, {:.0f} commits/s",
+                cycles, commits, sec, sec ? cycles / sec / 1e3 : 0, sec ? commits / sec : 0));
+    mycpu_log->info("[prof] phase          s       %  ns/cycle");
+    fmt::memory_buffer json;
+    fmt::format_to(std::back_inserter(json), "{{\"cycles\": {}, \"commits\": {}, \"seconds\": {:.6f}, \"phases\": {{",
+            cycles, commits, sec);
+    for (int i = 0; i < NR_PHASE; i++) {
+        double phase_sec = acc[i] * sec_per_stamp;
+        mycpu_log->info(fmt::format("[prof] {:<6} {:>9.3f} {:>6.1f} {:>9.1f}", phase_name[i], phase_sec,
+                    total ? 100.0 * acc[i] / total : 0, cycles ? phase_sec * 1e9 / cycles : 0));
+        fmt::format_to(std::back_inserter(json), "{}\"{}\": {:.6f}", i ? ", " : "", phase_name[i], phase_sec);
+    }
+    fmt::format_to(std::back_inserter(json), "}}}}\n");
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (!fp || fwrite(json.data(), 1, json.size(), fp) != json.size())
+        mycpu_log->error("sim_prof fail to write %v", filename);
+    if (fp) fclose(fp);
+}/*}}}*/
+#endif
@@ -0,0 +1,172 @@
+#include "generated/autoconf.h"
+#ifdef CONFIG_WAVE_ON
+#include "testbench/wave_ctl.hpp"
+#include "easylogging++.h"
+#include <fmt/core.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+extern uint64_t ticks;
+extern el::Logger* mycpu_log;
+
+// the last tick of len ticks from from, len is at least 1
+static inline uint64_t last_tick(uint64_t from, uint64_t len){/*{{{*/
+    return len - 1 > UINT64_MAX - from ? UINT64_MAX : from + len - 1;
+}/*}}}*/
+
+wave_ctl::wave_ctl(Vmycpu_top* top, const std::string& wave_name, const char* spec, bool from_reset):/*{{{*/
+    base(CONFIG_WAVE_DIR "/" + wave_name), valid(true), opened(false), dumping(false), pc_trig(false),
+    until(0), next(UINT64_MAX), window(0), seg_start(0), seg(0), scanned(0) {
+    Verilated::traceEverOn(true);
+    top->trace(&tfp, 0);
+    valid = parse(spec);
+    if (!valid) return;
+    // --wave=fail alone keeps the window of a wave from here
+    if (trig.empty() && (from_reset || *spec)) start(ticks, UINT64_MAX, nullptr);
+    plan();
+}/*}}}*/
+
+bool wave_ctl::parse(const char* spec){/*{{{*/
+    std::string all(spec);
+    size_t pos = 0;
+    while (pos < all.size()) {
+        size_t end = std::min(all.find(',', pos), all.size());
+        std::string cond = all.substr(pos, end - pos);
+        pos = end + 1;
+        size_t colon = cond.find(':');
+        std::string key = cond.substr(0, colon);
+        const char* arg = colon == std::string::npos ? "" : cond.c_str() + colon + 1;
+        char* rest = nullptr;
+        trigger t = {TRIG_TICK, false, 0, UINT64_MAX, 0, ""};
+        bool good = *arg != '\0';
+        if (key == "tick" && good) {
+            t.from = strtoull(arg, &rest, 0);
+            if (*rest == '-') {
+                uint64_t to = strtoull(rest + 1, &rest, 0);
+                good = to >= t.from;
+                t.len = to - t.from + 1;
+            }
+        }
+        else if (key == "pc" && good) {
+            t.kind = TRIG_PC;
+            t.pc = strtoull(arg, &rest, 0);
+            if (*rest == '+') t.len = strtoull(rest + 1, &rest, 0);
+            pc_trig = true;
+        }
+        else if (key == "uart" && good) {
+            t.kind = TRIG_UART;
+            t.text = arg;
+            size_t plus = t.text.rfind('+');
+            if (plus != std::string::npos && plus > 0 && plus + 1 < t.text.size() &&
+                    std::all_of(t.text.begin() + plus + 1, t.text.end(), ::isdigit)) {
+                t.len = strtoull(t.text.c_str() + plus + 1, nullptr, 10);
+                t.text.resize(plus);
+            }
+        }
+        else if (key == "fail") {
+            window = good ? strtoull(arg, &rest, 0) : CONFIG_WAVE_WINDOW;
+            good = window > 0;
+            if (good && (!rest || *rest == '\0')) continue;
+        }
+        else good = false;
+        if (!good || (rest && *rest) || t.len == 0) {
+            mycpu_log->error("wave condition \"%v\" is not tick:A[-B], pc:ADDR[+N], uart:TEXT[+N] or fail[:N]", cond);
+            return false;
+        }
+        trig.push_back(t);
+    }
+    return true;
+}/*}}}*/
+
+std::string wave_ctl::file_name(int32_t segment) const{/*{{{*/
+    if (segment < 0) return base + "." CONFIG_WAVE_EXT;
+    return fmt::format("{}.{}.{}", base, segment, CONFIG_WAVE_EXT);
+}/*}}}*/
+
+std::string* wave_ctl::output_watch(){/*{{{*/
+    for (auto& t: trig) if (t.kind == TRIG_UART) return &output;
+    return nullptr;
+}/*}}}*/
+
+void wave_ctl::start(uint64_t ticks, uint64_t last, const char* why){/*{{{*/
+    until = dumping ? std::max(until, last) : last;
+    if (!opened) {
+        seg_start = ticks;
+        tfp.open(file_name(window ? 0 : -1).c_str());
+        if (window) remove(file_name(1).c_str());
+        opened = true;
+    }
+    if (why) mycpu_log->info("wave from tick %v, %v", ticks, why);
+    dumping = true;
+}/*}}}*/
+
+void wave_ctl::plan(){/*{{{*/
+    next = dumping && until != UINT64_MAX ? until + 1 : UINT64_MAX;
+    for (auto& t: trig)
+        if (t.kind == TRIG_TICK && !t.fired) next = std::min(next, t.from);
+}/*}}}*/
+
+void wave_ctl::update(uint64_t ticks){/*{{{*/
+    if (dumping && ticks > until) {
+        dumping = false;
+        mycpu_log->info("wave stops at tick %v", ticks);
+    }
+    for (auto& t: trig) {
+        if (t.kind != TRIG_TICK || t.fired || ticks < t.from) continue;
+        t.fired = true;
+        uint64_t last = last_tick(t.from, t.len);
+        if (ticks <= last) start(ticks, last, fmt::format("tick:{}-{}", t.from, last).c_str());
+    }
+    if (output.size() != scanned) {
+        // only the tail that may begin a text is kept
+        size_t keep = 0;
+        for (auto& t: trig) {
+            if (t.kind != TRIG_UART || t.fired) continue;
+            size_t from = scanned >= t.text.size() ? scanned - t.text.size() + 1 : 0;
+            if (output.find(t.text, from) != std::string::npos) {
+                t.fired = true;
+                start(ticks, last_tick(ticks, t.len), fmt::format("MyCPU printed \"{}\"", t.text).c_str());
+            }
+            else keep = std::max(keep, t.text.size() - 1);
+        }
+        if (output.size() > keep) output.erase(0, output.size() - keep);
+        scanned = output.size();
+    }
+    plan();
+}/*}}}*/
+
+void wave_ctl::retire(word_t pc, uint64_t ticks){/*{{{*/
+    pc_trig = false;
+    for (auto& t: trig) {
+        if (t.kind != TRIG_PC || t.fired) continue;
+        if (t.pc == pc) {
+            t.fired = true;
+            start(ticks, last_tick(ticks, t.len), fmt::format("pc " HEX_WORD " retired", pc).c_str());
+        }
+        else pc_trig = true;
+    }
+    plan();
+}/*}}}*/
+
+void wave_ctl::rotate(uint64_t ticks){/*{{{*/
+    tfp.close();
+    seg++;
+    tfp.open(file_name(seg % 2).c_str());
+    seg_start = ticks;
+}/*}}}*/
+
+void wave_ctl::finish(bool failed){/*{{{*/
+    if (!opened) return;
+    tfp.close();
+    opened = dumping = false;
+    if (!window) return;
+    if (!failed) {
+        remove(file_name(0).c_str());
+        remove(file_name(1).c_str());
+    }
+    else if (seg == 0) mycpu_log->info("wave before the failure is in %v", file_name(0));
+    else mycpu_log->info("wave before the failure is in %v then %v", file_name((seg + 1) % 2), file_name(seg % 2));
+}/*}}}*/
+#endif
@@ -16,13 +16,37 @@ static std::map<std::string, int> img_str_to_code{
 static const struct option table[] = {
     {"batch"    , no_argument      , NULL, 'b'},
     {"log"      , required_argument, NULL, 'l'},
+    {"axi-delay", required_argument, NULL, 'd'},
+    {"seed"     , required_argument, NULL, 's'},
+    {"jobs"     , required_argument, NULL, 'j'},
+    {"baseline" , required_argument, NULL, 'B'},
+    {"golden"   , required_argument, NULL, 'g'},
+    {"record"   , required_argument, NULL, 'r'},
+    {"replay"   , required_argument, NULL, 'R'},
+    {"load"     , required_argument, NULL, 'L'},
+    {"save"     , required_argument, NULL, 'S'},
+    {"restore"  , optional_argument, NULL, 'c'},
+    {"wave"     , required_argument, NULL, 'w'},
     {"help"     , no_argument      , NULL, 'h'},
+    {0          , 0                , NULL,  0 },
 };
 const char* arg_log_file = "trace.log";
 bool arg_batch_mode = false;
+const char* arg_axi_delay = CONFIG_AXI_DELAY;
+uint64_t arg_seed = 1;
+int arg_jobs = MUXDEF(CONFIG_TEST_PERF, CONFIG_PERF_JOBS, 1);
+const char* arg_perf_baseline = MUXDEF(CONFIG_TEST_PERF, CONFIG_PERF_BASELINE, "");
+const char* arg_golden = "";
+const char* arg_record = "";
+const char* arg_replay = "";
+const char* arg_ckpt_load = "";
+const char* arg_ckpt_save = "";
+uint64_t arg_ckpt_at = 0;
+int arg_restore = -1;
+const char* arg_wave = "";
 void parse_args(int argc, char *argv[]) {
     int o;
-    while ( (o = getopt_long(argc, argv, "bl:i:", table, NULL)) != -1) {
+    while ( (o = getopt_long(argc, argv, "bl:i:d:s:j:B:g:r:R:L:S:c::w:", table, NULL)) != -1) {
         switch (o) {
             case 'l': 
                 arg_log_file = optarg; 
@@ -30,10 +54,61 @@ void parse_args(int argc, char *argv[]) {
             case 'b': 
                 arg_batch_mode = true; 
                 break;
+            case 'd':
+                arg_axi_delay = optarg;
+                break;
+            case 's':
+                arg_seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'j':
+                arg_jobs = atoi(optarg);
+                break;
+            case 'B':
+                arg_perf_baseline = optarg;
+                break;
+            case 'g':
+                arg_golden = optarg;
+                break;
+            case 'r':
+                arg_record = optarg;
+                break;
+            case 'R':
+                arg_replay = optarg;
+                break;
+            case 'L':
+                arg_ckpt_load = optarg;
+                break;
+            case 'S': {
+                char* file;
+                arg_ckpt_at = strtoull(optarg, &file, 0);
+                if (*file == ':' && file[1]) {
+                    arg_ckpt_save = file + 1;
+                    break;
+                }
+                printf("--save wants N:FILE, not %s\n", optarg);
+                exit(1);
+            }
+            case 'c':
+                arg_restore = optarg ? atoi(optarg) : 0;
+                break;
+            case 'w':
+                arg_wave = optarg;
+                break;
             default:
                 printf("Usage: %s [OPTION...] [args]\n\n", argv[0]);
                 printf("\t-b,--batch              run with batch mode\n");
                 printf("\t-l,--log=FILE           output log to FILE\n");
+                printf("\t-d,--axi-delay=MODEL    AXI latency model: zero, fixed:N, random:MIN:MAX, ddr:CL:RCD:RP\n");
+                printf("\t-s,--seed=N             seed of the random AXI latency\n");
+                printf("\t-j,--jobs=N             run N perference test programs at the same time, 0 for all cores\n");
+                printf("\t-B,--baseline=FILE      compare the perference test with FILE, the perf-score.csv of an earlier run\n");
+                printf("\t-g,--golden=FILE        check the function test with the golden trace FILE instead of nemu\n");
+                printf("\t-r,--record=DIR         write the commits of nemu to DIR/<test>.ref\n");
+                printf("\t-R,--replay=DIR         check MyCPU with DIR/<test>.ref, nemu only runs after a difference\n");
+                printf("\t-L,--load=FILE          nemu starts from the checkpoint FILE\n");
+                printf("\t-S,--save=N:FILE        nemu saves a checkpoint to FILE after N instructions\n");
+                printf("\t-c,--restore[=N]        run from the newest checkpoint of the simulation (N older) with waves\n");
+                printf("\t-w,--wave=COND[,COND]   dump the wave after tick:A[-B], pc:ADDR[+N], uart:TEXT[+N]; fail[:N] keeps the last N ticks of a failure\n");
                 printf("\t-i,--img=IMAGE NAME     IMAGE NAME is in set {func, perf}");
                 printf("\n");
                 exit(0);
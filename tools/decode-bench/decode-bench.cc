@@ -0,0 +1,97 @@
+/*
+ * Compare the linear INSTPAT scan with the build time decode table.
+ * usage: decode-bench [-r rounds] image.bin...
+ * Every word of the images is decoded by both, results must be identical.
+ */
+
+#include "common.hpp"
+#include "nemu/cpu/decode.hpp"
+#include "decode-table.hpp"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <vector>
+
+#undef INSTPAT
+static constexpr inst_pattern inst_patterns[] = {
+#define INSTPAT(pattern, name, type, ...) inst_pattern(pattern),
+#include "inst-list.hpp"
+#undef INSTPAT
+};
+static constexpr const char* inst_name[] = {
+#define INSTPAT(pattern, name, type, ...) #name,
+#include "inst-list.hpp"
+#undef INSTPAT
+};
+static constexpr auto inst_table = DECODE_TABLE(inst_patterns);
+
+// the decoder before the table: try every pattern in order
+static int linear_decode(uint32_t inst) {/*{{{*/
+    int idx = 0;
+#define INSTPAT(pattern, ...) do { \
+    uint64_t key, mask, shift; \
+    pattern_decode(pattern, STRLEN(pattern), &key, &mask, &shift); \
+    if (((inst >> shift) & mask) == key) return idx; \
+    idx++; \
+} while (0);
+#include "inst-list.hpp"
+#undef INSTPAT
+    return -1;
+}/*}}}*/
+
+static int table_decode(uint32_t inst) { return inst_table.match(inst); }
+
+template <typename F>
+static double bench(F decode, const std::vector<uint32_t>& words, int rounds, long& sink) {/*{{{*/
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (uint32_t w : words) sink += decode(w);
+    }
+    std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+    return ns.count() / ((double)words.size() * rounds);
+}/*}}}*/
+
+int main(int argc, char *argv[]) {
+    int rounds = 50;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        if (opt == 'r') rounds = atoi(optarg);
+        else {
+            fprintf(stderr, "usage: %s [-r rounds] image.bin...\n", argv[0]);
+            return 1;
+        }
+    }
+    std::vector<uint32_t> words;
+    for (int i = optind; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::in | std::ios::binary);
+        Assert(file, "file %s open error", argv[i]);
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t old = words.size();
+        words.resize(old + bytes.size() / 4);
+        memcpy(&words[old], bytes.data(), (bytes.size() / 4) * 4);
+    }
+    Assert(!words.empty(), "no instruction to decode");
+
+    int mismatch = 0;
+    for (uint32_t w : words) {
+        int l = linear_decode(w), t = table_decode(w);
+        if (l != t && mismatch++ < 10) {
+            printf("mismatch at %08x: linear %s, table %s\n", w,
+                    l < 0 ? "none" : inst_name[l], t < 0 ? "none" : inst_name[t]);
+        }
+    }
+    if (mismatch) {
+        printf("%d mismatch in %zu words\n", mismatch, words.size());
+        return 1;
+    }
+
+    long sink = 0;
+    double linear = bench(linear_decode, words, rounds, sink);
+    double table  = bench(table_decode, words, rounds, sink);
+    printf("%zu words x %d rounds, %d patterns (checksum %ld)\n",
+            words.size(), rounds, ARRLEN(inst_patterns), sink);
+    printf("linear: %6.2f ns/inst\n", linear);
+    printf("table : %6.2f ns/inst (%.1fx)\n", table, linear / table);
+    return 0;
+}
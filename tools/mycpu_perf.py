@@ -5,6 +5,7 @@ import matplotlib.pyplot as plt
 class inst_info:
     def __init__(self):
         self.pc:int
+        self.asid:int
         self.isEnterance:bool
         self.runTime:int
         self.allTicks:list = []
@@ -23,29 +24,38 @@ class basic_block:
 
 
 filename = "./perf-10.bin"
-headFmt = "=IcI"
-timeFmt = "=If"
+headFmt = "=8sII"
 headSize = st.calcsize(headFmt)
-timeSize = st.calcsize(timeFmt)
+recType = np.dtype([("pc", "<u4"), ("ticks", "<u4"), ("consume", "<f4"), ("asid", "<u4")])
 
-inst_list:list = []
+# a perf_head, then one record per commit; a partial record at the end of
+# an aborted run is dropped
 with open(filename, "rb") as fp:
-    while True:
-        bytesRes = fp.read(headSize)
-        if bytesRes == b'':break
-
-        inst = inst_info()
-        res = st.unpack(headFmt, bytesRes)
-        inst.pc = res[0]
-        inst.isEnterance = res[1]==b'\x01'
-        inst.runTime = res[2]
-        for i in range(inst.runTime):
-            bytesRes = fp.read(timeSize)
-            res = st.unpack(timeFmt,bytesRes)
-            inst.allTicks.append(res[0])
-            inst.allConsume.append(res[1])
-        inst_list.append(inst)
-fp.close
+    magic, version, recSize = st.unpack(headFmt, fp.read(headSize))
+    assert magic == b"HITDPERF" and recSize == recType.itemsize, "not an inst_timer stream"
+    raw = fp.read()
+recs = np.frombuffer(raw[:len(raw) - len(raw) % recSize], dtype=recType)
+
+# instructions are told apart by (asid, pc), asid is 0 for unmapped code;
+# bit 0 of pc marks a delay slot, both the next pc and the fall through of
+# its branch are block enterances
+isSlot = (recs["pc"] & 1) == 1
+keys = recs["asid"].astype(np.uint64) << np.uint64(32) | (recs["pc"] & ~np.uint32(1))
+enter = set((keys[isSlot] + np.uint64(4)).tolist())
+enter |= set(keys[1:][isSlot[:-1]].tolist())
+
+order = np.argsort(keys, kind="stable")
+uniq, starts = np.unique(keys[order], return_index=True)
+inst_list:list = []
+for key, idx in zip(uniq.tolist(), np.split(order, starts[1:])):
+    inst = inst_info()
+    inst.pc = key & 0xffffffff
+    inst.asid = key >> 32
+    inst.isEnterance = key in enter
+    inst.runTime = len(idx)
+    inst.allTicks = recs["ticks"][idx].tolist()
+    inst.allConsume = recs["consume"][idx].tolist()
+    inst_list.append(inst)
 
 blist:list = []
 blk = basic_block()
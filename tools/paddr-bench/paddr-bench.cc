@@ -0,0 +1,199 @@
+/*
+ * Compare the device search of PaddrTop before its page table with
+ * PaddrTop itself, on the memory maps of boot_soc and kernel_soc, then
+ * cache line refills read beat by beat with burst_read.
+ * usage: paddr-bench [-n accesses] [-r rounds]
+ * Every sampled read must return the same data through both.
+ */
+
+#include "common.hpp"
+#include "paddr/paddr_interface.hpp"
+#include <chrono>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+INITIALIZE_EASYLOGGINGPP
+
+// registers of a 16KB MMIO device, stands for Puart8250
+class mmio_stub: public PaddrInterface {/*{{{*/
+    public:
+        word_t reg[8] = {};
+        bool do_read (word_t addr, wen_t info, word_t* data) { *data = reg[BITS(addr, 4, 2)]; return true; }
+        bool do_write(word_t addr, wen_t info, const word_t data) { reg[BITS(addr, 4, 2)] = data; return true; }
+};/*}}}*/
+
+// PaddrTop::do_read/do_write before the page table
+class linear_top {/*{{{*/
+    public:
+        std::vector<std::pair<AddrIntv, PaddrInterface*>> devices;
+        bool do_read (word_t addr, wen_t info, word_t* data){
+            for (auto it: devices){
+                AddrIntv dev_range = it.first;
+                if (dev_range.start<=addr && (addr+info.size-1)<=dev_range.end()){
+                    return it.second->do_read(addr & dev_range.mask, info, data);
+                }
+            }
+            return false;
+        }
+        bool do_write(word_t addr, wen_t info, const word_t data){
+            for (auto it: devices){
+                AddrIntv dev_range = it.first;
+                if (dev_range.start<=addr && (addr+info.size-1)<=dev_range.end()){
+                    return it.second->do_write(addr & dev_range.mask, info, data);
+                }
+            }
+            return false;
+        }
+};/*}}}*/
+
+struct soc_map {
+    const char* name;
+    PaddrTop top;
+    linear_top linear;
+    // (range, share of accesses in percent)
+    std::vector<std::pair<AddrIntv, int>> mix;
+    void add(AddrIntv range, PaddrInterface* dev, int share) {
+        top.add_dev(range, dev);
+        linear.devices.push_back(std::make_pair(range, dev));
+        mix.push_back(std::make_pair(range, share));
+    }
+};
+
+static Pmem* new_pmem(AddrIntv range) {
+    Pmem* mem = new Pmem(range);
+    memset(mem->get_mem_ptr(), 0x5a, range.mask + 1);
+    return mem;
+}
+
+// same ranges as boot_soc() and kernel_soc() of src/soc.cpp
+static void boot_soc(soc_map& soc) {/*{{{*/
+    AddrIntv flash_range(0x1fc00000, bit_mask(21));
+    AddrIntv ddr_range  (0x00000000, bit_mask(27));
+    AddrIntv uart_range (0x1fe40000, bit_mask(14));
+    soc.name = "boot_soc";
+    soc.add(flash_range, new_pmem(flash_range), 25);
+    soc.add(ddr_range, new_pmem(ddr_range), 70);
+    soc.add(uart_range, new mmio_stub(), 5);
+}/*}}}*/
+static void kernel_soc(soc_map& soc) {/*{{{*/
+    AddrIntv ddr_range  (0x00000000, bit_mask(27));
+    AddrIntv uart_range (0x1fe40000, bit_mask(14));
+    soc.name = "kernel_soc";
+    soc.add(ddr_range, new_pmem(ddr_range), 95);
+    soc.add(uart_range, new mmio_stub(), 5);
+}/*}}}*/
+
+struct mem_access { word_t addr; wen_t info; };
+
+static std::vector<mem_access> gen_access(soc_map& soc, int n) {/*{{{*/
+    std::mt19937 rng(1);
+    std::vector<mem_access> res(n);
+    for (auto &a: res) {
+        int pick = rng() % 100;
+        size_t i = 0;
+        for (; i + 1 < soc.mix.size() && pick >= soc.mix[i].second; i++) pick -= soc.mix[i].second;
+        AddrIntv range = soc.mix[i].first;
+        int size = 1 << (rng() % 3);
+        // a 256KB working set, host cache misses would hide the lookup
+        a.addr = range.start + (rng() & range.mask & 0x3ffff & ~(size - 1));
+        a.info.size = size;
+        a.info.wstrb = 0xf;
+    }
+    return res;
+}/*}}}*/
+
+template <typename T>
+static double bench(T& top, const std::vector<mem_access>& acc, int rounds, word_t& sink) {/*{{{*/
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (auto &a: acc) {
+            word_t data = 0;
+            top.do_read(a.addr, a.info, &data);
+            sink += data;
+            top.do_write(a.addr ^ 0x40, a.info, data);
+        }
+    }
+    std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+    return ns.count() / ((double)acc.size() * rounds * 2);
+}/*}}}*/
+
+static int run(soc_map& soc, int n, int rounds) {/*{{{*/
+    std::vector<mem_access> acc = gen_access(soc, n);
+    int mismatch = 0;
+    for (auto &a: acc) {
+        word_t l = 0, t = 0;
+        soc.linear.do_read(a.addr, a.info, &l);
+        soc.top.do_read(a.addr, a.info, &t);
+        if (l != t && mismatch++ < 10) printf("mismatch at %08x: linear %08x, table %08x\n", a.addr, l, t);
+    }
+    if (mismatch) return 1;
+    word_t sink = 0;
+    double linear = bench(soc.linear, acc, rounds, sink);
+    double table  = bench(soc.top, acc, rounds, sink);
+    printf("%-10s %d accesses x %d rounds (checksum %08x)\n", soc.name, n, rounds, sink);
+    printf("  linear: %6.2f ns/access\n", linear);
+    printf("  table : %6.2f ns/access (%.1fx)\n", table, linear / table);
+    return 0;
+}/*}}}*/
+
+// refills of len word beats, as axi_paddr issued them before and with burst_read
+static int run_burst(soc_map& soc, int n, int rounds, int len, burst_t burst) {/*{{{*/
+    std::mt19937 rng(2);
+    std::vector<word_t> addr(n);
+    wen_t info = {.size = 4, .wstrb = 0xf};
+    word_t line = len * 4;
+    for (auto &a: addr) a = (rng() & 0x3ffff & ~(line - 1)) + (burst == BURST_WRAP ? (rng() % len) * 4 : 0);
+    word_t beat[16], copy[16], sink = 0;
+    for (auto a: addr) {
+        for (int i = 0; i < len; i++) soc.top.do_read(burst_beat_addr(a, 4, len, burst, i), info, &beat[i]);
+        soc.top.burst_read(a, info, len, burst, (uint8_t*)copy);
+        if (memcmp(beat, copy, line)) {
+            printf("burst mismatch at %08x\n", a);
+            return 1;
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (auto a: addr) {
+            for (int i = 0; i < len; i++) soc.top.do_read(burst_beat_addr(a, 4, len, burst, i), info, &beat[i]);
+            sink += beat[len - 1];
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (auto a: addr) {
+            soc.top.burst_read(a, info, len, burst, (uint8_t*)copy);
+            sink += copy[len - 1];
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> per_beat = mid - start, whole = end - mid;
+    double total = (double)n * rounds;
+    printf("%-10s %2d beat %s refill (checksum %08x)\n", soc.name, len, burst == BURST_WRAP ? "WRAP" : "INCR", sink);
+    printf("  per beat: %6.2f ns/refill\n", per_beat.count() / total);
+    printf("  burst   : %6.2f ns/refill (%.1fx)\n", whole.count() / total, per_beat.count() / whole.count());
+    return 0;
+}/*}}}*/
+
+int main(int argc, char *argv[]) {
+    int n = 1 << 20, rounds = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        if (opt == 'n') n = atoi(optarg);
+        else if (opt == 'r') rounds = atoi(optarg);
+        else {
+            fprintf(stderr, "usage: %s [-n accesses] [-r rounds]\n", argv[0]);
+            return 1;
+        }
+    }
+    soc_map boot, kernel;
+    boot_soc(boot);
+    kernel_soc(kernel);
+    int res = run(boot, n, rounds) | run(kernel, n, rounds);
+    for (int len: {8, 16}) {
+        res |= run_burst(kernel, n / 4, rounds, len, BURST_INCR);
+        res |= run_burst(kernel, n / 4, rounds, len, BURST_WRAP);
+    }
+    return res;
+}